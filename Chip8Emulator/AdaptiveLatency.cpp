@@ -0,0 +1,59 @@
+#include "AdaptiveLatency.h"
+
+AdaptiveLatency::AdaptiveLatency()
+	: m_underruns(0), m_samplesWritten(0), m_queuedSamples(0), m_targetSamples(MIN_SAMPLES), m_samplesSinceUnderrun(0), m_started(false)
+{
+}
+
+void AdaptiveLatency::observe(uint32_t queuedSamples)
+{
+	m_queuedSamples.store(queuedSamples, std::memory_order_relaxed);
+	if (m_started && queuedSamples == 0) underrun();
+}
+
+void AdaptiveLatency::underrun()
+{
+	m_underruns.fetch_add(1, std::memory_order_relaxed);
+	m_samplesSinceUnderrun = 0;
+	m_started = false; // the device restarts from empty, don't count it again until something has been written
+
+	uint32_t target = m_targetSamples.load(std::memory_order_relaxed) * 2;
+	m_targetSamples.store(target < MAX_SAMPLES ? target : MAX_SAMPLES, std::memory_order_relaxed);
+}
+
+bool AdaptiveLatency::hasRoom(uint32_t queuedSamples) const
+{
+	return queuedSamples < m_targetSamples.load(std::memory_order_relaxed);
+}
+
+void AdaptiveLatency::written(uint32_t samples)
+{
+	m_started = true;
+	m_samplesWritten.fetch_add(samples, std::memory_order_relaxed);
+
+	m_samplesSinceUnderrun += samples;
+	uint32_t target = m_targetSamples.load(std::memory_order_relaxed);
+	if (m_samplesSinceUnderrun >= SHRINK_AFTER_SAMPLES && target > MIN_SAMPLES)
+	{
+		// a quarter at a time (whole blocks, at least one) so a burst of stalls is forgotten within seconds, not minutes
+		uint32_t step = (target / 4) / BLOCK_SAMPLES * BLOCK_SAMPLES;
+		if (step < BLOCK_SAMPLES) step = BLOCK_SAMPLES;
+		m_targetSamples.store(target - step > MIN_SAMPLES ? target - step : MIN_SAMPLES, std::memory_order_relaxed);
+		m_samplesSinceUnderrun = 0;
+	}
+}
+
+uint32_t AdaptiveLatency::getTargetSamples() const
+{
+	return m_targetSamples.load(std::memory_order_relaxed);
+}
+
+AudioStats AdaptiveLatency::getStats() const
+{
+	AudioStats stats;
+	stats.underruns = m_underruns.load(std::memory_order_relaxed);
+	stats.samplesWritten = m_samplesWritten.load(std::memory_order_relaxed);
+	stats.queuedSamples = m_queuedSamples.load(std::memory_order_relaxed);
+	stats.targetSamples = m_targetSamples.load(std::memory_order_relaxed);
+	return stats;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+
+struct AudioStats
+{
+	uint64_t underruns;		// times the device ran dry
+	uint64_t samplesWritten;
+	uint32_t queuedSamples; // on the device the last time the backend looked
+	uint32_t targetSamples; // how much the backend is currently trying to keep queued
+};
+
+// Decides how much audio a backend keeps queued on the device: as little as the host can keep fed.
+// The target starts at MIN_SAMPLES, doubles after every underrun and shrinks back down by a quarter
+// every SHRINK_AFTER_SAMPLES that play without one. The audio thread drives it, anyone can read getStats().
+class AdaptiveLatency
+{
+public:
+	static const uint32_t BLOCK_SAMPLES = 128;		   // ~3ms at 44.1kHz, the unit everything is written in
+	static const uint32_t MIN_SAMPLES = 2 * BLOCK_SAMPLES;
+	static const uint32_t MAX_SAMPLES = 64 * BLOCK_SAMPLES; // ~190ms, about twice the old fixed buffer
+	static const uint32_t SHRINK_AFTER_SAMPLES = 2 * 44100; // two seconds
+
+	AdaptiveLatency();
+
+	// audio thread only
+	void observe(uint32_t queuedSamples); // the device's queue depth right before writing, an empty queue counts as an underrun
+	void underrun(); // for backends that are told about underruns directly
+	bool hasRoom(uint32_t queuedSamples) const; // whether another block should be written yet
+	void written(uint32_t samples);
+	uint32_t getTargetSamples() const;
+
+	AudioStats getStats() const;
+
+private:
+	std::atomic<uint64_t> m_underruns;
+	std::atomic<uint64_t> m_samplesWritten;
+	std::atomic<uint32_t> m_queuedSamples;
+	std::atomic<uint32_t> m_targetSamples;
+	uint64_t m_samplesSinceUnderrun;
+	bool m_started; // nothing has been written yet, so an empty queue isn't an underrun
+};
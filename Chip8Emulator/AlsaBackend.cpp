@@ -0,0 +1,108 @@
+#ifdef CHIP8_HAS_ALSA
+
+#include <alsa/asoundlib.h>
+
+#include "AlsaBackend.h"
+#include <chrono>
+#include <cerrno>
+
+AlsaBackend::AlsaBackend()
+	: m_pcm(nullptr), m_source(nullptr), m_running(false)
+{
+}
+
+AlsaBackend::~AlsaBackend()
+{
+	close();
+}
+
+bool AlsaBackend::open(SampleSource* source)
+{
+	if (snd_pcm_open(&m_pcm, "default", SND_PCM_STREAM_PLAYBACK, 0) < 0)
+	{
+		m_pcm = nullptr;
+		return false;
+	}
+
+	// resampling allowed, so devices that can't do 44.1kHz natively still work
+	if (snd_pcm_set_params(m_pcm, SND_PCM_FORMAT_S16, SND_PCM_ACCESS_RW_INTERLEAVED, 1, SAMPLE_RATE, 1, BUFFER_US) < 0 || !configure())
+	{
+		snd_pcm_close(m_pcm);
+		m_pcm = nullptr;
+		return false;
+	}
+
+	m_source = source;
+	m_running = true;
+	m_thread = std::thread(&AlsaBackend::run, this);
+	return true;
+}
+
+void AlsaBackend::close()
+{
+	if (!m_pcm) return;
+
+	m_running = false;
+	m_thread.join();
+	snd_pcm_drop(m_pcm);
+	snd_pcm_close(m_pcm);
+	m_pcm = nullptr;
+}
+
+bool AlsaBackend::configure()
+{
+	snd_pcm_sw_params_t* parameters;
+	snd_pcm_sw_params_alloca(&parameters);
+	if (snd_pcm_sw_params_current(m_pcm, parameters) < 0) return false;
+	if (snd_pcm_sw_params_set_start_threshold(m_pcm, parameters, AdaptiveLatency::BLOCK_SAMPLES) < 0) return false;
+	return snd_pcm_sw_params(m_pcm, parameters) >= 0;
+}
+
+void AlsaBackend::run()
+{
+	int16_t block[AdaptiveLatency::BLOCK_SAMPLES];
+	while (m_running)
+	{
+		snd_pcm_sframes_t queued = 0;
+		if (snd_pcm_delay(m_pcm, &queued) < 0)
+		{
+			// only fails once the device has already run dry (or been suspended)
+			m_latency.underrun();
+			if (snd_pcm_recover(m_pcm, -EPIPE, 1) < 0) return;
+			queued = 0;
+		}
+		else
+		{
+			if (queued < 0) queued = 0;
+			m_latency.observe(static_cast<uint32_t>(queued));
+		}
+
+		if (!m_latency.hasRoom(static_cast<uint32_t>(queued)))
+		{
+			// sleep until roughly one block has played out of the target
+			std::this_thread::sleep_for(std::chrono::microseconds(AdaptiveLatency::BLOCK_SAMPLES * 1000000ull / SAMPLE_RATE / 2));
+			continue;
+		}
+
+		m_source->render(block, AdaptiveLatency::BLOCK_SAMPLES);
+
+		const int16_t* remaining = block;
+		snd_pcm_uframes_t left = AdaptiveLatency::BLOCK_SAMPLES;
+		while (left > 0 && m_running)
+		{
+			snd_pcm_sframes_t written = snd_pcm_writei(m_pcm, remaining, left);
+			if (written < 0)
+			{
+				// underrun or suspend, recover and try again
+				if (written == -EPIPE) m_latency.underrun();
+				if (snd_pcm_recover(m_pcm, static_cast<int>(written), 1) < 0) return;
+				continue;
+			}
+			remaining += written;
+			left -= static_cast<snd_pcm_uframes_t>(written);
+		}
+		m_latency.written(AdaptiveLatency::BLOCK_SAMPLES);
+	}
+}
+
+#endif
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "AudioBackend.h"
+
+#ifdef CHIP8_HAS_ALSA
+
+#include <atomic>
+#include <thread>
+
+typedef struct _snd_pcm snd_pcm_t;
+
+// ALSA "default" PCM, written from its own thread
+// snd_pcm_delay says exactly how much is queued, so this is paced on that rather than on blocking writes
+class AlsaBackend : public AudioBackend
+{
+private:
+	// the device buffer is sized for the largest target, how much of it is actually used is paced by m_latency
+	static const unsigned int BUFFER_US = static_cast<unsigned int>(2ull * AdaptiveLatency::MAX_SAMPLES * 1000000 / SAMPLE_RATE);
+
+	snd_pcm_t* m_pcm;
+	SampleSource* m_source;
+	std::thread m_thread;
+	std::atomic<bool> m_running;
+
+	void run();
+	bool configure(); // start playing after the first block instead of once the whole buffer is full
+
+public:
+	AlsaBackend();
+	~AlsaBackend();
+
+	bool open(SampleSource* source) override;
+	void close() override;
+	const char* getName() const override { return "alsa"; }
+};
+
+#endif
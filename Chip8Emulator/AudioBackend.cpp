@@ -0,0 +1,37 @@
+#include "AudioBackend.h"
+#include "WaveOutBackend.h"
+#include "PulseBackend.h"
+#include "AlsaBackend.h"
+
+namespace
+{
+	std::unique_ptr<AudioBackend> create(const std::string& name)
+	{
+		(void)name; // every comparison below can be compiled out
+#ifdef _WIN32
+		if (name == "waveout") return std::unique_ptr<AudioBackend>(new WaveOutBackend());
+#endif
+#ifdef CHIP8_HAS_PULSE
+		if (name == "pulse") return std::unique_ptr<AudioBackend>(new PulseBackend());
+#endif
+#ifdef CHIP8_HAS_ALSA
+		if (name == "alsa") return std::unique_ptr<AudioBackend>(new AlsaBackend());
+#endif
+		return nullptr;
+	}
+}
+
+std::unique_ptr<AudioBackend> AudioBackend::open(const std::string& name, SampleSource* source)
+{
+	// pulse first, going straight to alsa fights the sound server on most desktops
+	const char* candidates[] = { "waveout", "pulse", "alsa" };
+
+	for (const char* candidate : candidates)
+	{
+		if (name != "auto" && name != candidate) continue;
+
+		std::unique_ptr<AudioBackend> backend = create(candidate);
+		if (backend && backend->open(source)) return backend;
+	}
+	return nullptr;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "AdaptiveLatency.h"
+
+// Produces mono 16 bit samples, called on the audio backend's thread
+class SampleSource
+{
+public:
+	virtual ~SampleSource() {}
+
+	virtual void render(int16_t* samples, size_t count) = 0;
+};
+
+// A sound device that plays whatever a SampleSource renders, pulling blocks on its own thread.
+// Which ones exist depends on the platform and build flags:
+//     waveout  Win32 (olcNoiseMaker)
+//     pulse    PulseAudio simple API, define CHIP8_HAS_PULSE and link pulse-simple + pulse
+//     alsa     ALSA, define CHIP8_HAS_ALSA and link asound
+class AudioBackend
+{
+public:
+	static const unsigned int SAMPLE_RATE = 44100;
+
+	virtual ~AudioBackend() {}
+
+	virtual bool open(SampleSource* source) = 0; // returns false if there's no usable device
+	virtual void close() = 0;
+	virtual const char* getName() const = 0;
+
+	AudioStats getStats() const { return m_latency.getStats(); } // safe to call from any thread
+
+	// opens the named backend, "auto" tries each one that was compiled in
+	// returns nullptr if nothing could be opened, in which case there's no point generating audio at all
+	static std::unique_ptr<AudioBackend> open(const std::string& name, SampleSource* source);
+
+protected:
+	AdaptiveLatency m_latency; // the backends write in AdaptiveLatency::BLOCK_SAMPLES blocks and keep it up to date
+};
@@ -0,0 +1,169 @@
+#include <cstring>
+
+#include "BatchRunner.h"
+
+namespace
+{
+	void runUntil(Core& core, uint64_t cycle)
+	{
+		while (core.getCycleCount() < cycle)
+		{
+			uint64_t remaining = cycle - core.getCycleCount();
+			core.run(static_cast<uint32_t>(remaining < 0x10000000 ? remaining : 0x10000000));
+		}
+	}
+}
+
+BatchRunner::BatchRunner(unsigned int threadCount, Dispatch dispatch)
+	: m_threadCount(threadCount), m_dispatch(dispatch), m_core(nullptr, &m_keypad, nullptr), m_generation(0), m_busy(0),
+	m_stopping(false), m_jobs(nullptr), m_results(nullptr)
+{
+	if (m_threadCount == 0) m_threadCount = std::thread::hardware_concurrency();
+	if (m_threadCount == 0) m_threadCount = 1;
+
+	m_core.setDispatch(m_dispatch);
+	m_queues.reset(new WorkQueue[m_threadCount]);
+	for (unsigned int i = 1; i < m_threadCount; i++)
+	{
+		m_workers.emplace_back(&BatchRunner::workerLoop, this, i);
+	}
+}
+
+BatchRunner::~BatchRunner()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_started.notify_all();
+	for (size_t i = 0; i < m_workers.size(); i++)
+	{
+		m_workers[i].join();
+	}
+}
+
+std::vector<BatchResult> BatchRunner::run(const std::vector<BatchJob>& jobs)
+{
+	std::vector<BatchResult> results(jobs.size());
+
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		WorkQueue& queue = m_queues[i % m_threadCount];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back(i);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs = &jobs;
+		m_results = &results;
+		m_busy = m_threadCount - 1;
+		m_generation++;
+	}
+	m_started.notify_all();
+
+	work(0, m_core, m_keypad);
+
+	// a worker can still be finishing a job it stole, results isn't complete until they've all left
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_finished.wait(lock, [this]() { return m_busy == 0; });
+	m_jobs = nullptr;
+	m_results = nullptr;
+	return results;
+}
+
+void BatchRunner::workerLoop(unsigned int self)
+{
+	Keypad keypad;
+	Core core(nullptr, &keypad, nullptr);
+	core.setDispatch(m_dispatch);
+
+	uint64_t generation = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_started.wait(lock, [&]() { return m_stopping || m_generation != generation; });
+			if (m_stopping) return;
+			generation = m_generation;
+		}
+
+		work(self, core, keypad);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (--m_busy == 0) m_finished.notify_one();
+	}
+}
+
+void BatchRunner::work(unsigned int self, Core& core, Keypad& keypad)
+{
+	size_t job;
+	for (;;)
+	{
+		bool found = popOwn(m_queues[self], job);
+		for (unsigned int i = 1; !found && i < m_threadCount; i++)
+		{
+			found = steal(m_queues[(self + i) % m_threadCount], job);
+		}
+		if (!found) return; // nothing is added once a run has started, so empty everywhere means done
+
+		runJob(core, keypad, (*m_jobs)[job], (*m_results)[job]);
+	}
+}
+
+bool BatchRunner::popOwn(WorkQueue& queue, size_t& job)
+{
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.jobs.empty()) return false;
+	job = queue.jobs.back();
+	queue.jobs.pop_back();
+	return true;
+}
+
+bool BatchRunner::steal(WorkQueue& queue, size_t& job)
+{
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.jobs.empty()) return false;
+	job = queue.jobs.front();
+	queue.jobs.pop_front();
+	return true;
+}
+
+void BatchRunner::runJob(const BatchJob& job, Dispatch dispatch, BatchResult& result)
+{
+	Keypad keypad;
+	Core core(nullptr, &keypad, nullptr);
+	core.setDispatch(dispatch);
+	runJob(core, keypad, job, result);
+}
+
+void BatchRunner::runJob(Core& core, Keypad& keypad, const BatchJob& job, BatchResult& result)
+{
+	static const Rom empty;
+
+	keypad.setKeys(0);
+	core.seed(job.seed);
+	core.setSpriteWrapping(job.wrapSprites);
+	core.loadProgram(job.program ? *job.program : empty);
+
+	for (size_t i = 0; i < job.input.size() && job.input[i].cycle < job.cycles; i++)
+	{
+		runUntil(core, job.input[i].cycle);
+
+		uint16_t pressed = job.input[i].keys & ~keypad.getKeys();
+		keypad.setKeys(job.input[i].keys);
+		for (uint8_t key = 0; key < 16; key++)
+		{
+			if ((pressed >> key) & 0x01)
+			{
+				core.keyPressed(key);
+				break;
+			}
+		}
+	}
+	runUntil(core, job.cycles);
+
+	memcpy(result.framebuffer, core.getFramebuffer(), sizeof(result.framebuffer));
+	result.stateHash = core.stateHash();
+	result.instructionCount = core.getInstructionCount();
+}
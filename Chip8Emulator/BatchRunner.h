@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "Core.h"
+#include "Rom.h"
+
+// keypad state to switch to once the Core reaches cycle
+struct InputEvent
+{
+	uint64_t cycle;
+	uint16_t keys; // bit n set = key n held
+};
+
+struct BatchJob
+{
+	std::shared_ptr<const Rom> program; // jobs running the same ROM can share one image
+	uint32_t seed;
+	std::vector<InputEvent> input; // sorted by cycle
+	uint64_t cycles;
+	bool wrapSprites = false; // see Core::setSpriteWrapping
+};
+
+struct BatchResult
+{
+	uint64_t framebuffer[32];
+	uint64_t stateHash;
+	uint64_t instructionCount;
+};
+
+// Runs many independent headless Cores over a pool of threads.
+// Jobs are dealt out round robin, and a thread that runs out of work steals from the front of another thread's queue,
+// so a few long-running ROMs don't leave the other threads idle.
+// The threads (and their Cores) live as long as the runner, so a search that calls run() with a handful of jobs at a
+// time doesn't pay for creating and joining them every call. The thread calling run() works through jobs too.
+class BatchRunner
+{
+private:
+	struct WorkQueue
+	{
+		std::mutex mutex;
+		std::deque<size_t> jobs;
+	};
+
+	unsigned int m_threadCount;
+	Dispatch m_dispatch;
+	Keypad m_keypad; // the calling thread's
+	Core m_core;
+	std::unique_ptr<WorkQueue[]> m_queues; // one per thread, the caller's is 0
+
+	std::mutex m_mutex;
+	std::condition_variable m_started;	// a run handed out jobs, or the runner is being destroyed
+	std::condition_variable m_finished; // the last worker left the current run
+	uint64_t m_generation;				// bumped by every run, so a worker never joins the same one twice
+	unsigned int m_busy;				// workers that haven't left the current run yet
+	bool m_stopping;
+	const std::vector<BatchJob>* m_jobs; // the current run's, only touched between m_started and m_finished
+	std::vector<BatchResult>* m_results;
+
+	std::vector<std::thread> m_workers;
+
+public:
+	BatchRunner(unsigned int threadCount = 0, Dispatch dispatch = CHIP8_DEFAULT_DISPATCH); // 0 = one per hardware thread
+	~BatchRunner();
+
+	std::vector<BatchResult> run(const std::vector<BatchJob>& jobs); // one at a time
+
+	// runs a single job on the calling thread
+	static void runJob(const BatchJob& job, Dispatch dispatch, BatchResult& result);
+
+private:
+	void workerLoop(unsigned int self);
+	void work(unsigned int self, Core& core, Keypad& keypad); // until every queue is empty
+	static bool popOwn(WorkQueue& queue, size_t& job); // from the back, thieves take from the front
+	static bool steal(WorkQueue& queue, size_t& job);
+
+	// each worker keeps one Core and resets it between jobs, so the jit and decode caches are only allocated once per thread
+	static void runJob(Core& core, Keypad& keypad, const BatchJob& job, BatchResult& result);
+};
@@ -0,0 +1,175 @@
+#include "BeeperAudio.h"
+#include "Core.h"
+#include <cmath>
+#include <algorithm>
+
+const double BeeperAudio::AMPLITUDE = 0.2;
+const double BeeperAudio::MAX_RATE_ADJUST = 0.005;
+
+BeeperAudio::BeeperAudio(Timing timing)
+	: m_timing(timing), m_droppedEdges(0), m_lastQueued(false), m_hasPending(false), m_emulatedCycle(0), m_step(CURSOR_ONE), m_toneEnabled(false), m_cursor(0), m_anchored(timing == Timing::Emulated), m_phase(0)
+{
+	buildTable();
+}
+
+// sum of the odd harmonics below Nyquist, each tapered by a Lanczos sigma factor to keep the ringing at the edges down
+void BeeperAudio::buildTable()
+{
+	const double pi = 3.14159265358979323846;
+	const int harmonics = AudioBackend::SAMPLE_RATE / 2 / FREQUENCY;
+
+	double wave[TABLE_SIZE];
+	double peak = 0.0;
+	for (uint32_t i = 0; i < TABLE_SIZE; i++)
+	{
+		double phase = 2.0 * pi * i / TABLE_SIZE;
+		double value = 0.0;
+		for (int k = 1; k <= harmonics; k += 2)
+		{
+			double x = pi * k / (harmonics + 1);
+			value += std::sin(x) / x * std::sin(k * phase) / k;
+		}
+		wave[i] = value;
+		peak = std::max(peak, std::fabs(value));
+	}
+
+	for (uint32_t i = 0; i < TABLE_SIZE; i++)
+	{
+		m_table[i] = static_cast<int32_t>(std::lround(wave[i] / peak * AMPLITUDE * 32767.0));
+	}
+}
+
+void BeeperAudio::setToneEnabled(bool enabled, uint64_t cycle)
+{
+	ToneEvent event;
+	event.enabled = enabled;
+	event.cycle = cycle;
+	flushPending();
+	queue(event);
+}
+
+void BeeperAudio::setEmulatedTime(uint64_t cycle)
+{
+	flushPending();
+	m_emulatedCycle.store(cycle, std::memory_order_relaxed);
+}
+
+uint64_t BeeperAudio::getDroppedEdges() const
+{
+	return m_droppedEdges.load(std::memory_order_relaxed);
+}
+
+// render() only takes an edge once its cursor reaches it, so a long uncapped batch of a beeping ROM can queue far more
+// edges than fit. the ones in between don't matter by the time render() gets there, only where the tone ends up does
+void BeeperAudio::queue(const ToneEvent& event)
+{
+	if (!m_hasPending && m_events.push(event))
+	{
+		m_lastQueued = event.enabled;
+		return;
+	}
+
+	if (m_hasPending) m_droppedEdges.fetch_add(1, std::memory_order_relaxed); // superseded
+	m_pending = event;
+	m_hasPending = true;
+	if (m_pending.enabled == m_lastQueued)
+	{
+		// back to the state the queue already ends in, nothing left to tell render()
+		m_hasPending = false;
+		m_droppedEdges.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void BeeperAudio::flushPending()
+{
+	if (m_hasPending && m_events.push(m_pending))
+	{
+		m_lastQueued = m_pending.enabled;
+		m_hasPending = false;
+	}
+}
+
+double BeeperAudio::getRate() const
+{
+	return static_cast<double>(m_step.load(std::memory_order_relaxed)) / CURSOR_ONE;
+}
+
+uint64_t BeeperAudio::getSamplePosition(uint64_t cycle)
+{
+	// split so the multiply can't overflow however long it runs
+	uint64_t seconds = cycle / Core::CYCLES_PER_SECOND;
+	uint64_t remainder = cycle % Core::CYCLES_PER_SECOND;
+	uint64_t position = seconds * AudioBackend::SAMPLE_RATE * CURSOR_ONE;
+	return position + remainder * AudioBackend::SAMPLE_RATE * CURSOR_ONE / Core::CYCLES_PER_SECOND;
+}
+
+// proportional control on how far the cursor is behind the emulation, once per block
+void BeeperAudio::updateRate()
+{
+	int64_t emulated = static_cast<int64_t>(getSamplePosition(m_emulatedCycle.load(std::memory_order_relaxed)));
+	int64_t distance = emulated - static_cast<int64_t>(m_cursor);
+	int64_t target = LIVE_TARGET * CURSOR_ONE;
+
+	if (!m_anchored || distance < 0 || distance > LIVE_MAX_DISTANCE * CURSOR_ONE)
+	{
+		m_cursor = (emulated > target) ? static_cast<uint64_t>(emulated - target) : 0;
+		m_anchored = true;
+		distance = emulated - static_cast<int64_t>(m_cursor);
+	}
+
+	double error = static_cast<double>(distance - target) / target;
+	error = std::max(-1.0, std::min(1.0, error));
+	m_step.store(static_cast<uint32_t>(std::lround(CURSOR_ONE * (1.0 + MAX_RATE_ADJUST * error))), std::memory_order_relaxed);
+}
+
+void BeeperAudio::render(int16_t* samples, size_t count)
+{
+	if (m_timing == Timing::Live) updateRate();
+	const uint64_t step = m_step.load(std::memory_order_relaxed);
+
+	// split the block at every edge that falls inside it
+	size_t done = 0;
+	ToneEvent event;
+	while (done < count)
+	{
+		size_t length = count - done;
+		if (m_events.peek(event))
+		{
+			uint64_t cursor = m_cursor + done * step;
+			uint64_t at = getSamplePosition(event.cycle);
+			if (at <= cursor)
+			{
+				m_events.pop(event);
+				if (event.enabled && !m_toneEnabled) m_phase = 0; // start every beep on a zero crossing
+				m_toneEnabled = event.enabled;
+				continue;
+			}
+			uint64_t until = (at - cursor + step - 1) / step;
+			if (until < length) length = static_cast<size_t>(until);
+		}
+
+		synthesize(samples + done, length);
+		done += length;
+	}
+	m_cursor += count * step;
+}
+
+void BeeperAudio::synthesize(int16_t* samples, size_t count)
+{
+	if (!m_toneEnabled)
+	{
+		std::fill(samples, samples + count, static_cast<int16_t>(0));
+		return;
+	}
+
+	// the phase of each sample is computed from the start of the block rather than carried from the previous one,
+	// so there's no dependency between iterations and the loop vectorizes
+	// (that also needs a 32 bit counter, the compiler won't vectorize the index math with a size_t one)
+	const uint32_t start = m_phase;
+	const uint32_t length = static_cast<uint32_t>(count);
+	for (uint32_t i = 0; i < length; i++)
+	{
+		samples[i] = static_cast<int16_t>(m_table[(start + i * PHASE_STEP) >> (32 - TABLE_BITS)]);
+	}
+	m_phase = start + static_cast<uint32_t>(count) * PHASE_STEP;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Sinks.h"
+#include "AudioBackend.h"
+#include "AdaptiveLatency.h"
+#include "SpscQueue.h"
+
+#include <atomic>
+
+// a 440Hz square wave while the sound timer is running
+// tone changes are queued by the emulation thread with the emulated cycle they happened on, and render() (on the audio
+// backend's thread) switches the tone at the matching sample inside the block, so beeps are exactly as long as the timer says
+//
+// render() walks a cursor through emulated time. in Emulated timing it moves exactly one sample of emulated time per sample.
+// in Live timing the sound card's clock and the host's clock (which paces emulation) never quite agree, so the cursor is kept
+// LIVE_TARGET behind the emulated time the core last reported by nudging its speed up to MAX_RATE_ADJUST either way,
+// proportional to how far off it is. a tiny resampler, except the tone itself is synthesized at the output rate so the pitch
+// doesn't wobble, only the timing of the edges follows the emulation clock
+class BeeperAudio : public AudioSink, public SampleSource
+{
+public:
+	enum class Timing
+	{
+		Live,	 // a sound device pulls samples in real time, the cursor follows the emulation clock
+		Emulated // samples are pulled for emulated time, sample n is cycle n * CYCLES_PER_SECOND / SAMPLE_RATE exactly
+	};
+
+	explicit BeeperAudio(Timing timing = Timing::Live);
+
+	void setToneEnabled(bool enabled, uint64_t cycle) override;
+	void setEmulatedTime(uint64_t cycle) override;
+	void render(int16_t* samples, size_t count) override;
+
+	double getRate() const; // emulated samples per output sample, 1.0 when the clocks agree
+	uint64_t getDroppedEdges() const; // tone changes collapsed away because render() fell too far behind to queue them
+
+private:
+	static const int FREQUENCY = 440;
+	static const int TABLE_BITS = 11;
+	static const uint32_t TABLE_SIZE = 1 << TABLE_BITS;
+	static const uint32_t PHASE_STEP = static_cast<uint32_t>((static_cast<uint64_t>(FREQUENCY) << 32) / AudioBackend::SAMPLE_RATE);
+	static const double AMPLITUDE;
+
+	// the cursor is a 48.16 fixed point sample position, so the step can be fractional without drifting
+	static const int CURSOR_FRACTION_BITS = 16;
+	static const uint32_t CURSOR_ONE = 1u << CURSOR_FRACTION_BITS;
+	// this is the floor on how late a beep can start, ahead of whatever the backend has queued on the device. the emulation
+	// thread runs a tick's worth of cycles at once, so an edge can't be played until up to a tick after its cycle and the
+	// distance to the cursor swings by a tick. a few blocks on top of that cover the host's scheduling jitter
+	static const int64_t TICK_SAMPLES = AudioBackend::SAMPLE_RATE / 60;
+	static const int64_t LIVE_TARGET = TICK_SAMPLES + 3 * AdaptiveLatency::BLOCK_SAMPLES; // ~25ms
+	static const int64_t LIVE_MAX_DISTANCE = 16 * TICK_SAMPLES; // further than this (host stall, --max-speed) it just jumps
+	static const double MAX_RATE_ADJUST;
+
+	struct ToneEvent
+	{
+		bool enabled;
+		uint64_t cycle;
+	};
+
+	Timing m_timing;
+	SpscQueue<ToneEvent, 64> m_events;
+	std::atomic<uint64_t> m_droppedEdges;
+
+	// emulation thread only. once the queue is full every further edge collapses into m_pending, which holds the state the
+	// tone ends up in and is retried on every call, so the last edge (the one that turns a beep off) is never lost
+	bool m_lastQueued; // state of the newest edge in the queue
+	bool m_hasPending;
+	ToneEvent m_pending;
+	std::atomic<uint64_t> m_emulatedCycle; // how far the core has run, written by the emulation thread
+	std::atomic<uint32_t> m_step;		   // cursor advance per output sample, only atomic so getRate() can read it
+
+	// everything below is render side only
+	bool m_toneEnabled;
+	uint64_t m_cursor;	// emulated sample position of the next output sample, fixed point
+	bool m_anchored;	// m_cursor has been lined up with the emulation, always true for Emulated
+	uint32_t m_phase;	// one period is the full 32 bit range, so it wraps exactly and never loses precision
+	int32_t m_table[TABLE_SIZE]; // one period of a square wave with nothing above Nyquist so it doesn't alias, 32 bit so it can be gathered
+
+	void buildTable();
+	void queue(const ToneEvent& event);
+	void flushPending();
+	void updateRate();
+	static uint64_t getSamplePosition(uint64_t cycle); // fixed point
+	void synthesize(int16_t* samples, size_t count);
+};
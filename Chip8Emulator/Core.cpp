@@ -1,15 +1,8 @@
-#include <glad/glad.h>
-#include <GLFW/glfw3.h>
+#include <iostream>
+#include <cstring>
 
-#include "Keys.h"
 #include "Core.h"
 
-double MakeNoise(int nChannel, double dTime)
-{
-	double dOutput = sin(440.0 * 2.0 * 3.14159 * dTime);
-	return dOutput * 0.5; // Master Volume
-}
-
 uint8_t Core::fontset[80] = {
 	0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
 	0x20, 0x60, 0x20, 0x20, 0x70, // 1
@@ -29,117 +22,74 @@ uint8_t Core::fontset[80] = {
 	0xF0, 0x80, 0xF0, 0x80, 0x80  // F
 };
 
-void Core::updateFramebuffer(uint8_t xPos, uint8_t yPos, uint8_t height)
-{
-	int xByte = xPos / 8;
-	int xOffset = xPos % 8;
-	int yByte = yPos * 8;
-	bool checkForPixelDeactivation = true;
-	registers[0xF] = 0x00; // clear collision bit
-
-	// 0 | 00000000 11111111
-	// 1 | 10000000 01111111
-	// 2 | 11000000 00111111
-	// 3 | 11100000 00011111
-	// 4 | 11110000 00001111
-	// 5 | 11111000 00000111
-	// 6 | 11111100 00000011
-	// 7 | 11111110 00000001
-
-	uint16_t masks[8] = {
-		0b0000000011111111,
-		0b1000000001111111,
-		0b1100000000111111,
-		0b1110000000011111,
-		0b1111000000001111,
-		0b1111100000000111,
-		0b1111110000000011,
-		0b1111111000000001
-	};
+
+Core::Opcode Core::opcodeTable[16];
+Core::Opcode Core::subtable0[256];
+Core::Opcode Core::subtable8[16];
+Core::Opcode Core::subtableE[256];
+Core::Opcode Core::subtableF[256];
+
+bool Core::updateFramebuffer(uint64_t* framebuffer, const uint8_t* sprite, uint8_t xPos, uint8_t yPos, uint8_t height, bool wrap)
+{
+	unsigned int x = xPos % 64;
+	unsigned int y = yPos % 32;
+	uint64_t collision = 0;
 
 	for (uint8_t i = 0; i < height; i++)
 	{
-		int framebufferIndex = yByte + xByte + (i * 8);
-		uint16_t oldFramebufferWord = (framebuffer[framebufferIndex] << 8) | framebuffer[framebufferIndex + 1];
-		uint8_t oldByte = oldFramebufferWord >> (8 - xOffset);
-		uint8_t newByte = memory[indexRegister + i];
-
-		if (checkForPixelDeactivation && isPixelDeactivated(oldByte, newByte))
+		unsigned int row = y + i;
+		if (row >= 32)
 		{
-			registers[0x0F] = 0x01;
-			checkForPixelDeactivation = false;
+			if (!wrap) break;
+			row -= 32;
 		}
 
-		newByte = oldByte ^ newByte;
+		// sprite row lined up with the left edge, then shifted (or rotated) into place
+		uint64_t spriteRow = static_cast<uint64_t>(sprite[i]) << 56;
+		uint64_t bits = wrap ? (spriteRow >> x) | (spriteRow << ((64 - x) & 63)) : spriteRow >> x;
 
-		uint16_t newFramebufferWord = 0x0000;
-		newFramebufferWord = newByte << (8 - xOffset);
-		
-		newFramebufferWord = newFramebufferWord | (oldFramebufferWord & masks[xOffset]);
-		framebuffer[framebufferIndex] = newFramebufferWord >> 8;
-		framebuffer[framebufferIndex + 1] = newFramebufferWord;
+		collision |= framebuffer[row] & bits;
+		framebuffer[row] ^= bits;
 	}
+	return collision != 0;
 }
 
-bool Core::isPixelDeactivated(uint8_t oldByte, uint8_t newByte)
+const uint8_t* Core::spriteAt(const uint8_t* memory, uint16_t address, uint8_t height, uint8_t* wrapped)
 {
-	uint8_t oldBit = 0x00;
-	uint8_t newBit = 0x00;
-	for (int i = 0; i < 8; i++)
+	if (address + height <= 4096) return &memory[address];
+	for (uint8_t i = 0; i < height; i++)
 	{
-		oldBit = (oldByte >> i) & 0x01;
-		newBit = (newByte >> i) & 0x01;
-		if (oldBit == 0x01 && newBit == 0x01) return true;
+		wrapped[i] = memory[(address + i) & 0x0FFF];
 	}
-	return false;
-}
-
-double Core::soundCallback(int channels, double deltaTime)
-{
-	double targetFrequency = 0.0;
-	if (soundTimer > 0) targetFrequency = 440.0;
-	double dOutput = sin(targetFrequency * 2.0 * 3.14159 * deltaTime);
-	return dOutput * 0.25;
+	return wrapped;
 }
 
-Core::Core(GLFWwindow* context)
-	: indexRegister(0x0000), programCounter(0x0200), stackPointer(-1), delayTimer(0x00), soundTimer(0x00), windowContext(context), isWaitingForInput(false)
+// timer ticks always land between slices, so cycleCount is exactly when the edge happened
+void Core::setSoundTimer(uint8_t value, uint64_t cycle)
 {
-	for (int i = 0; i < 16; i++)
+	bool wasEnabled = soundTimer > 0;
+	soundTimer = value;
+	if (audio && wasEnabled != (soundTimer > 0))
 	{
-		registers[i] = 0x00;
+		audio->setToneEnabled(soundTimer > 0, cycle);
 	}
+}
 
-	for (int i = 0; i < 16; i++)
-	{
-		stack[i] = 0x0000;
-	}
-
-	for (int i = 0; i < 256; i++)
-	{
-		framebuffer[i] = 0x00;
-	}
-
-	for (int i = 0; i < 4096; i++)
-	{
-		memory[i] = 0x00;
-	}
-
-	generator = new std::default_random_engine(std::random_device{}());
-	distribution = new std::uniform_int_distribution<int>(0x00, 0xFF);
-
-	renderer = new Renderer();
+Core::Core(DisplaySink* display, const Keypad* keypad, AudioSink* audio)
+	: display(display), keypad(keypad), audio(audio), rom(nullptr), indexRegister(0x0000), programCounter(0x0200), stackPointer(-1),
+	delayTimer(0x00), soundTimer(0x00), isWaitingForInput(false), sliceInterrupted(false), toneEdgePending(false), pendingRegister(0),
+	wrapSprites(false), framebufferDirty(true), cycleCount(0), instructionCount(0), dispatch(CHIP8_DEFAULT_DISPATCH)
+{
+	reset();
 
-	std::vector<wstring> devices = olcNoiseMaker<short>::Enumerate();
-	sound = new olcNoiseMaker<short>(devices[0], 44100, 1, 8, 512);
-	sound->SetUserFunction(std::bind(&Core::soundCallback, this, std::placeholders::_1, std::placeholders::_2));
+	seed(std::random_device{}());
 
-	// load fontset into memory
-	for (int i = 0; i < 80; i++)
-	{
-		memory[i] = fontset[i];
-	}
+	static const bool tablesInitialized = (initTables(), true); // thread safe, batch runs construct cores concurrently
+	(void)tablesInitialized;
+}
 
+void Core::initTables()
+{
 	opcodeTable[0x0] = &Core::opcode0;
 	opcodeTable[0x1] = &Core::opcode1nnn;
 	opcodeTable[0x2] = &Core::opcode2nnn;
@@ -195,44 +145,183 @@ Core::Core(GLFWwindow* context)
 	subtableF[0x33] = &Core::opcodeFx33;
 	subtableF[0x55] = &Core::opcodeFx55;
 	subtableF[0x65] = &Core::opcodeFx65;
+}
+
+void Core::loadProgram(const Rom& rom)
+{
+	this->rom = &rom;
+	reset();
+}
+
+void Core::reset()
+{
+	if (soundTimer > 0) setSoundTimer(0, cycleCount); // don't leave the sink beeping
+
+	memset(registers, 0, sizeof(registers));
+	indexRegister = 0x0000;
+	programCounter = 0x0200;
+	stackPointer = -1;
+	delayTimer = 0x00;
+	memset(stack, 0, sizeof(stack));
+	memset(framebuffer, 0, sizeof(framebuffer));
+
+	memcpy(memory, fontset, sizeof(fontset));
+	memset(memory + sizeof(fontset), 0, sizeof(memory) - sizeof(fontset));
+	if (rom) memcpy(memory + 0x0200, rom->getData(), rom->getSize());
+	dirtyPages = 0xFFFF; // nothing in memory came from a fork page
+
+	isWaitingForInput = false;
+	sliceInterrupted = false;
+	toneEdgePending = false;
+	pendingRegister = 0;
+	framebufferDirty = true;
+	cycleCount = 0;
+	instructionCount = 0;
+
+	invalidateDecodeCache();
+	if (jit) jit->invalidateAll();
+}
+
+void Core::seed(uint32_t seed)
+{
+	rngState = seed % 2147483647;
+	if (rngState == 0) rngState = 1; // zero would stick, minstd_rand::seed does the same
+}
+
+uint32_t Core::nextRandom()
+{
+	rngState = static_cast<uint32_t>(static_cast<uint64_t>(rngState) * 48271 % 2147483647);
+	return rngState;
+}
+
+// Snapshot and ForkedState only differ in how they hold memory, everything else has the same names
+template <typename State>
+void Core::saveRegisters(State& state) const
+{
+	state.cycleCount = cycleCount;
+	state.instructionCount = instructionCount;
+	memcpy(state.framebuffer, framebuffer, sizeof(framebuffer));
+	state.rngState = rngState;
+	state.indexRegister = indexRegister;
+	state.programCounter = programCounter;
+	memcpy(state.stack, stack, sizeof(stack));
+	memcpy(state.registers, registers, sizeof(registers));
+	state.stackPointer = stackPointer;
+	state.delayTimer = delayTimer;
+	state.soundTimer = soundTimer;
+	state.isWaitingForInput = isWaitingForInput;
+	state.pendingRegister = pendingRegister;
+}
+
+template <typename State>
+void Core::loadRegisters(const State& state)
+{
+	// tells the sink about the tone at the state's time, a sink running off emulated time sees the clock jump
+	setSoundTimer(state.soundTimer, state.cycleCount);
+
+	cycleCount = state.cycleCount;
+	instructionCount = state.instructionCount;
+	memcpy(framebuffer, state.framebuffer, sizeof(framebuffer));
+	rngState = state.rngState;
+	indexRegister = state.indexRegister;
+	programCounter = state.programCounter;
+	memcpy(stack, state.stack, sizeof(stack));
+	memcpy(registers, state.registers, sizeof(registers));
+	stackPointer = state.stackPointer;
+	delayTimer = state.delayTimer;
+	isWaitingForInput = state.isWaitingForInput != 0;
+	pendingRegister = state.pendingRegister & 0x0F;
+
+	sliceInterrupted = false;
+	toneEdgePending = false;
+	framebufferDirty = true; // whatever the display has is from another point in time
+}
+
+// nearby states only differ in a few bytes, so pages that already match are left alone and only the decoded/compiled
+// code of the bytes that changed is dropped, instead of throwing the lot away on every load
+void Core::restorePage(size_t page, const uint8_t* source)
+{
+	uint8_t* destination = memory + page * MemoryPage::SIZE;
+	if (memcmp(destination, source, MemoryPage::SIZE) == 0) return;
 
-	draw(); // initial draw just in case
+	if (!decodeCache && !jit)
+	{
+		memcpy(destination, source, MemoryPage::SIZE);
+		dirtyPages |= 1 << page;
+		return;
+	}
+
+	for (size_t i = 0; i < MemoryPage::SIZE; i++)
+	{
+		if (destination[i] != source[i]) writeMemory(static_cast<uint16_t>(page * MemoryPage::SIZE + i), source[i]);
+	}
 }
 
-Core::~Core()
+void Core::save(Snapshot& snapshot) const
 {
-	delete generator;
-	delete distribution;
-	delete sound;
+	snapshot.magic = Snapshot::MAGIC;
+	snapshot.version = Snapshot::VERSION;
+	saveRegisters(snapshot);
+	memset(snapshot.reserved, 0, sizeof(snapshot.reserved));
+	memcpy(snapshot.memory, memory, sizeof(memory));
 }
 
-void Core::loadProgram()
+bool Core::load(const Snapshot& snapshot)
 {
-	std::ifstream file(".\\c8roms\\c8games\\PONG", std::ios::binary);
-	if (!file.is_open()) 
+	if (snapshot.magic != Snapshot::MAGIC || snapshot.version != Snapshot::VERSION) return false;
+
+	loadRegisters(snapshot);
+	for (size_t page = 0; page < ForkedState::PAGE_COUNT; page++)
 	{
-		std::cout << "Failed to open ROM." << std::endl;
-		abort();
+		restorePage(page, snapshot.memory + page * MemoryPage::SIZE);
+	}
+	return true;
+}
+
+static_assert(ForkedState::PAGE_COUNT <= 16, "dirtyPages has one bit per page");
+
+void Core::fork(ForkedState& child)
+{
+	saveRegisters(child);
+	for (size_t page = 0; page < ForkedState::PAGE_COUNT; page++)
+	{
+		// a page nothing has written to since the last fork or load is still identical to the one it came from
+		if (((dirtyPages >> page) & 0x01) || !forkPages[page])
+		{
+			std::shared_ptr<MemoryPage> copy = std::make_shared<MemoryPage>();
+			memcpy(copy->bytes, memory + page * MemoryPage::SIZE, MemoryPage::SIZE);
+			forkPages[page] = copy;
+		}
+		child.pages[page] = forkPages[page];
 	}
-	int ptr = 0;
-	char buffer[4096 - 0x0200] = { 0 };
-	while (!file.eof())
+	dirtyPages = 0;
+}
+
+bool Core::load(const ForkedState& state)
+{
+	for (size_t page = 0; page < ForkedState::PAGE_COUNT; page++)
 	{
-		file.read(buffer + ptr, 1);
-		ptr++;
+		if (!state.pages[page]) return false;
 	}
 
-	for (int i = 0x0200; i < 4096; i++)
+	loadRegisters(state);
+	for (size_t page = 0; page < ForkedState::PAGE_COUNT; page++)
 	{
-		memory[i] = static_cast<uint8_t>(buffer[i - 0x0200]);
+		// same page object and untouched since means memory already holds it
+		if (state.pages[page] == forkPages[page] && !((dirtyPages >> page) & 0x01)) continue;
+
+		restorePage(page, state.pages[page]->bytes);
+		forkPages[page] = state.pages[page];
 	}
+	dirtyPages = 0;
+	return true;
 }
 
 void Core::opcode()
 {
 	//log();
 
-	currOpcode = memory[programCounter] << 8 | memory[programCounter + 1];
+	currOpcode = memory[programCounter & 0x0FFF] << 8 | memory[(programCounter + 1) & 0x0FFF];
 	currRegX = (currOpcode & 0x0F00) >> 8;
 	currRegY = (currOpcode & 0x00F0) >> 4;
 
@@ -242,46 +331,463 @@ void Core::opcode()
 	programCounter += 2;
 }
 
-void Core::draw()
+RunState Core::run(uint32_t cycles)
+{
+	// run in slices that end on a timer tick so every dispatch engine sees the timers change at the same instruction
+	while (cycles > 0 && !isWaitingForInput)
+	{
+		uint32_t untilTick = CYCLES_PER_TIMER_TICK - static_cast<uint32_t>(cycleCount % CYCLES_PER_TIMER_TICK);
+		uint32_t slice = (cycles < untilTick) ? cycles : untilTick;
+
+		uint32_t executed = execute(slice);
+		instructionCount += executed;
+
+		if (sliceInterrupted)
+		{
+			sliceInterrupted = false;
+			// Fx18 stops the slice right after itself so the tone edge gets the exact cycle, the rest of the slice runs next time round
+			// Fx0A stops it too, any cycles left over in the slice were spent blocked on it
+			if (!isWaitingForInput) slice = executed;
+		}
+
+		cycleCount += slice;
+		cycles -= slice;
+		if (toneEdgePending)
+		{
+			toneEdgePending = false;
+			if (audio) audio->setToneEnabled(soundTimer > 0, cycleCount);
+		}
+		if (cycleCount % CYCLES_PER_TIMER_TICK == 0)
+		{
+			tickTimers();
+		}
+	}
+
+	// suspended, nothing runs until keyPressed so skip the rest without stepping through it
+	if (cycles > 0)
+	{
+		uint64_t ticks = (cycleCount + cycles) / CYCLES_PER_TIMER_TICK - cycleCount / CYCLES_PER_TIMER_TICK;
+		tickTimers(ticks);
+		cycleCount += cycles;
+	}
+
+	if (audio) audio->setEmulatedTime(cycleCount);
+	return isWaitingForInput ? RunState::WaitingForKey : RunState::Running;
+}
+
+void Core::setDispatch(Dispatch dispatch)
+{
+	this->dispatch = dispatch;
+	if (dispatch == Dispatch::Cached && !decodeCache)
+	{
+		decodeCache.reset(new DecodedInstruction[4096 / 2]);
+		invalidateDecodeCache();
+	}
+	if (dispatch == Dispatch::Jit && !jit)
+	{
+		jit.reset(new ::Jit());
+	}
+}
+
+void Core::setSpriteWrapping(bool wrap)
 {
-	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-	glClear(GL_COLOR_BUFFER_BIT);
-	renderer->draw(framebuffer, 32, 64);
-	glfwSwapBuffers(windowContext);
+	wrapSprites = wrap;
 }
 
-void Core::updateDelayTimer(double currTime)
+void Core::setAudio(AudioSink* audio)
 {
-	if (delayTimer > 0)
+	this->audio = audio;
+}
+
+AudioSink* Core::getAudio() const
+{
+	return audio;
+}
+
+uint32_t Core::execute(uint32_t count)
+{
+	switch (dispatch)
 	{
-		double deltaTime = currTime - lastDelayTimerUpdate;
-		if (deltaTime >= (1.0 / 60.0))
+	case Dispatch::Switch:
+		return executeSwitch(count);
+	case Dispatch::Threaded:
+		return executeThreaded(count);
+	case Dispatch::Cached:
+		return executeCached(count);
+	case Dispatch::Jit:
+		return executeJit(count);
+	default:
+		return executeTable(count);
+	}
+}
+
+uint32_t Core::executeTable(uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		opcode();
+		if (sliceInterrupted) return i + 1;
+	}
+	return count;
+}
+
+uint32_t Core::executeSwitch(uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		currOpcode = memory[programCounter & 0x0FFF] << 8 | memory[(programCounter + 1) & 0x0FFF];
+		currRegX = (currOpcode & 0x0F00) >> 8;
+		currRegY = (currOpcode & 0x00F0) >> 4;
+
+		switch (currOpcode >> 12)
 		{
-			delayTimer--;
-			lastDelayTimerUpdate = currTime;
+		case 0x0:
+			switch (currOpcode & 0x00FF)
+			{
+			case 0xE0: opcode00E0(); break;
+			case 0xEE: opcode00EE(); break;
+			default: noOperation(); break;
+			}
+			break;
+		case 0x1: opcode1nnn(); break;
+		case 0x2: opcode2nnn(); break;
+		case 0x3: opcode3xkk(); break;
+		case 0x4: opcode4xkk(); break;
+		case 0x5: opcode5xy0(); break;
+		case 0x6: opcode6xkk(); break;
+		case 0x7: opcode7xkk(); break;
+		case 0x8:
+			switch (currOpcode & 0x000F)
+			{
+			case 0x0: opcode8xy0(); break;
+			case 0x1: opcode8xy1(); break;
+			case 0x2: opcode8xy2(); break;
+			case 0x3: opcode8xy3(); break;
+			case 0x4: opcode8xy4(); break;
+			case 0x5: opcode8xy5(); break;
+			case 0x6: opcode8xy6(); break;
+			case 0x7: opcode8xy7(); break;
+			case 0xE: opcode8xyE(); break;
+			default: noOperation(); break;
+			}
+			break;
+		case 0x9: opcode9xy0(); break;
+		case 0xA: opcodeAnnn(); break;
+		case 0xB: opcodeBnnn(); break;
+		case 0xC: opcodeCnnn(); break;
+		case 0xD: opcodeDxyn(); break;
+		case 0xE:
+			switch (currOpcode & 0x00FF)
+			{
+			case 0x9E: opcodeEx9E(); break;
+			case 0xA1: opcodeExA1(); break;
+			default: noOperation(); break;
+			}
+			break;
+		case 0xF:
+			switch (currOpcode & 0x00FF)
+			{
+			case 0x07: opcodeFx07(); break;
+			case 0x0A: opcodeFx0A(); break;
+			case 0x15: opcodeFx15(); break;
+			case 0x18: opcodeFx18(); break;
+			case 0x1E: opcodeFx1E(); break;
+			case 0x29: opcodeFx29(); break;
+			case 0x33: opcodeFx33(); break;
+			case 0x55: opcodeFx55(); break;
+			case 0x65: opcodeFx65(); break;
+			default: noOperation(); break;
+			}
+			break;
 		}
+
+		programCounter += 2;
+		if (sliceInterrupted) return i + 1;
 	}
+	return count;
 }
 
-void Core::updateSoundTimer(double currTime)
+uint32_t Core::executeCached(uint32_t count)
 {
-	if (soundTimer > 0)
+	for (uint32_t i = 0; i < count; i++)
 	{
-		double deltaTime = currTime - lastSoundTimerUpdate;
+		// odd addresses are legal jump targets but rare enough to not be worth caching
+		if (programCounter & 0xF001)
+		{
+			opcode();
+		}
+		else
+		{
+			DecodedInstruction& entry = decodeCache[programCounter >> 1];
+			if (!entry.handler) decode(programCounter, entry);
+
+			currOpcode = entry.opcode;
+			currRegX = entry.regX;
+			currRegY = entry.regY;
+			(this->*(entry.handler))();
+			programCounter += 2;
+		}
 
-		if (deltaTime >= (1.0 / 60.0))
+		if (sliceInterrupted) return i + 1;
+	}
+	return count;
+}
+
+uint32_t Core::executeJit(uint32_t count)
+{
+	uint32_t i = 0;
+	while (i < count)
+	{
+		const ::Jit::Block* block = jit->lookup(programCounter, memory);
+		if (block)
 		{
-			soundTimer--;
-			lastSoundTimerUpdate = currTime;
+			uint32_t ran = block->code(registers, &indexRegister, count - i);
+			programCounter += ran * 2;
+			i += ran;
 		}
+		else
+		{
+			opcode();
+			i++;
+			if (sliceInterrupted) return i;
+		}
+	}
+	return count;
+}
+
+void Core::decode(uint16_t address, DecodedInstruction& entry)
+{
+	entry.opcode = memory[address] << 8 | memory[(address + 1) & 0x0FFF];
+	entry.regX = (entry.opcode & 0x0F00) >> 8;
+	entry.regY = (entry.opcode & 0x00F0) >> 4;
+
+	switch (entry.opcode >> 12)
+	{
+	case 0x0: entry.handler = subtable0[entry.opcode & 0x00FF]; break;
+	case 0x8: entry.handler = subtable8[entry.opcode & 0x000F]; break;
+	case 0xE: entry.handler = subtableE[entry.opcode & 0x00FF]; break;
+	case 0xF: entry.handler = subtableF[entry.opcode & 0x00FF]; break;
+	default: entry.handler = opcodeTable[entry.opcode >> 12]; break;
+	}
+}
+
+void Core::invalidateDecodeCache()
+{
+	if (!decodeCache) return;
+	for (int i = 0; i < 4096 / 2; i++)
+	{
+		decodeCache[i].handler = nullptr;
+	}
+}
+
+void Core::writeMemory(uint16_t address, uint8_t value)
+{
+	address &= 0x0FFF;
+	memory[address] = value;
+	dirtyPages |= 1 << (address / MemoryPage::SIZE);
+	// a byte only ever belongs to the instruction at the even address at or just below it
+	if (decodeCache)
+	{
+		decodeCache[address >> 1].handler = nullptr;
+	}
+	if (jit) jit->invalidate(address);
+}
+
+#ifdef CHIP8_HAS_COMPUTED_GOTO
+uint32_t Core::executeThreaded(uint32_t count)
+{
+	// every handler ends in its own copy of the dispatch, so each gets its own indirect branch history
+	static void* const labels[16] = {
+		&&op0, &&op1nnn, &&op2nnn, &&op3xkk, &&op4xkk, &&op5xy0, &&op6xkk, &&op7xkk,
+		&&op8, &&op9xy0, &&opAnnn, &&opBnnn, &&opCnnn, &&opDxyn, &&opE, &&opF
+	};
+	static void* const labels8[16] = {
+		&&op8xy0, &&op8xy1, &&op8xy2, &&op8xy3, &&op8xy4, &&op8xy5, &&op8xy6, &&op8xy7,
+		&&nop, &&nop, &&nop, &&nop, &&nop, &&nop, &&op8xyE, &&nop
+	};
+	uint32_t executed = 0;
+
+#define DISPATCH() \
+	do { \
+		if (executed == count || sliceInterrupted) return executed; \
+		currOpcode = memory[programCounter & 0x0FFF] << 8 | memory[(programCounter + 1) & 0x0FFF]; \
+		currRegX = (currOpcode & 0x0F00) >> 8; \
+		currRegY = (currOpcode & 0x00F0) >> 4; \
+		executed++; \
+		goto *labels[currOpcode >> 12]; \
+	} while (0)
+#define NEXT() do { programCounter += 2; DISPATCH(); } while (0)
+
+	DISPATCH();
+
+op0:
+	switch (currOpcode & 0x00FF)
+	{
+	case 0xE0: opcode00E0(); break;
+	case 0xEE: opcode00EE(); break;
+	default: noOperation(); break;
 	}
+	NEXT();
+op1nnn: opcode1nnn(); NEXT();
+op2nnn: opcode2nnn(); NEXT();
+op3xkk: opcode3xkk(); NEXT();
+op4xkk: opcode4xkk(); NEXT();
+op5xy0: opcode5xy0(); NEXT();
+op6xkk: opcode6xkk(); NEXT();
+op7xkk: opcode7xkk(); NEXT();
+op8: goto *labels8[currOpcode & 0x000F];
+op8xy0: opcode8xy0(); NEXT();
+op8xy1: opcode8xy1(); NEXT();
+op8xy2: opcode8xy2(); NEXT();
+op8xy3: opcode8xy3(); NEXT();
+op8xy4: opcode8xy4(); NEXT();
+op8xy5: opcode8xy5(); NEXT();
+op8xy6: opcode8xy6(); NEXT();
+op8xy7: opcode8xy7(); NEXT();
+op8xyE: opcode8xyE(); NEXT();
+op9xy0: opcode9xy0(); NEXT();
+opAnnn: opcodeAnnn(); NEXT();
+opBnnn: opcodeBnnn(); NEXT();
+opCnnn: opcodeCnnn(); NEXT();
+opDxyn: opcodeDxyn(); NEXT();
+opE:
+	switch (currOpcode & 0x00FF)
+	{
+	case 0x9E: opcodeEx9E(); break;
+	case 0xA1: opcodeExA1(); break;
+	default: noOperation(); break;
+	}
+	NEXT();
+opF:
+	switch (currOpcode & 0x00FF)
+	{
+	case 0x07: opcodeFx07(); break;
+	case 0x0A: opcodeFx0A(); break;
+	case 0x15: opcodeFx15(); break;
+	case 0x18: opcodeFx18(); break;
+	case 0x1E: opcodeFx1E(); break;
+	case 0x29: opcodeFx29(); break;
+	case 0x33: opcodeFx33(); break;
+	case 0x55: opcodeFx55(); break;
+	case 0x65: opcodeFx65(); break;
+	default: noOperation(); break;
+	}
+	NEXT();
+nop: noOperation(); NEXT();
+
+#undef NEXT
+#undef DISPATCH
+}
+#else
+uint32_t Core::executeThreaded(uint32_t count)
+{
+	return executeSwitch(count);
 }
+#endif
 
-const bool Core::getIsWaitingForInput() const
+void Core::tickTimers()
+{
+	if (delayTimer > 0) delayTimer--;
+	if (soundTimer > 0) setSoundTimer(soundTimer - 1, cycleCount);
+}
+
+// same as calling tickTimers() ticks times
+void Core::tickTimers(uint64_t ticks)
+{
+	delayTimer = (delayTimer > ticks) ? static_cast<uint8_t>(delayTimer - ticks) : 0;
+	// called before cycleCount moves past the skipped ticks, if the tone stops it's on the soundTimer'th of them
+	uint64_t lastTick = (cycleCount / CYCLES_PER_TIMER_TICK + soundTimer) * CYCLES_PER_TIMER_TICK;
+	if (soundTimer > 0) setSoundTimer((soundTimer > ticks) ? static_cast<uint8_t>(soundTimer - ticks) : 0, lastTick);
+}
+
+void Core::draw()
+{
+	if (display) display->present(framebuffer);
+	framebufferDirty = false;
+}
+
+// the host calls this on its own refresh tick, sprite draws only mark the framebuffer dirty
+bool Core::presentIfDirty()
+{
+	if (!framebufferDirty) return false;
+	draw();
+	return true;
+}
+
+bool Core::getIsWaitingForInput() const
 {
 	return isWaitingForInput;
 }
 
+uint8_t Core::getPendingRegister() const
+{
+	return pendingRegister;
+}
+
+bool Core::getIsIdle() const
+{
+	return isWaitingForInput && delayTimer == 0 && soundTimer == 0;
+}
+
+uint64_t Core::getCycleCount() const
+{
+	return cycleCount;
+}
+
+uint64_t Core::getInstructionCount() const
+{
+	return instructionCount;
+}
+
+const uint64_t* Core::getFramebuffer() const
+{
+	return framebuffer;
+}
+
+bool Core::getIsFramebufferDirty() const
+{
+	return framebufferDirty;
+}
+
+uint64_t Core::stateHash() const
+{
+	return hashState(registers, indexRegister, programCounter, stackPointer, delayTimer, soundTimer, stack, framebuffer, memory);
+}
+
+uint64_t Core::hashState(const uint8_t* registers, uint16_t indexRegister, uint16_t programCounter, int8_t stackPointer,
+	uint8_t delayTimer, uint8_t soundTimer, const uint16_t* stack, const uint64_t* framebuffer, const uint8_t* memory)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	auto mix = [&hash](const void* data, size_t size)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ULL;
+		}
+	};
+
+	mix(registers, 16);
+	mix(&indexRegister, sizeof(indexRegister));
+	mix(&programCounter, sizeof(programCounter));
+	mix(&stackPointer, sizeof(stackPointer));
+	mix(&delayTimer, sizeof(delayTimer));
+	mix(&soundTimer, sizeof(soundTimer));
+	mix(stack, 16 * sizeof(uint16_t));
+	mix(framebuffer, sizeof(uint64_t) * 32);
+	mix(memory, 4096);
+	return hash;
+}
+
+void Core::keyPressed(uint8_t key)
+{
+	if (!isWaitingForInput) return;
+
+	registers[pendingRegister] = key & 0x0F;
+	isWaitingForInput = false;
+}
+
 void Core::log()
 {
 	std::cout << "OPCODE: " << std::hex << currOpcode << std::endl;
@@ -308,17 +814,18 @@ void Core::opcode0()
 // CLS
 void Core::opcode00E0()
 {
-	for (int i = 0; i < 32 * 8; i++)
+	for (int i = 0; i < 32; i++)
 	{
-		framebuffer[i] = 0x00;
+		framebuffer[i] = 0;
 	}
-	draw();
+	framebufferDirty = true;
 }
 
 // RET
+// the stack index wraps at 16 like addresses do at 4K, so an underflow or overflow lands on another slot, not outside
 void Core::opcode00EE()
 {
-	programCounter = stack[stackPointer];
+	programCounter = stack[stackPointer & 0x0F];
 	stackPointer--;
 }
 
@@ -331,7 +838,7 @@ void Core::opcode1nnn()
 void Core::opcode2nnn()
 {
 	stackPointer++;
-	stack[stackPointer] = programCounter; //!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+	stack[stackPointer & 0x0F] = programCounter; //!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 	programCounter = currOpcode & 0x0FFF;
 	programCounter -= 2; // similar to 0x1nnn !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!! or is it???????????????????
 }
@@ -493,14 +1000,17 @@ void Core::opcodeBnnn()
 
 void Core::opcodeCnnn()
 {
-	uint8_t result = static_cast<uint8_t>(distribution->operator()(*generator)); // ugly
+	uint8_t result = static_cast<uint8_t>(nextRandom() >> 23); // top 8 of minstd's 31 bits
 	registers[currRegX] = result & (currOpcode & 0x00FF);
 }
 
 void Core::opcodeDxyn()
 {
-	updateFramebuffer(registers[currRegX], registers[currRegY], currOpcode & 0x000F);
-	draw();
+	uint8_t wrapped[15];
+	const uint8_t* sprite = spriteAt(memory, indexRegister, currOpcode & 0x000F, wrapped);
+	bool collision = updateFramebuffer(framebuffer, sprite, registers[currRegX], registers[currRegY], currOpcode & 0x000F, wrapSprites);
+	registers[0x0F] = collision ? 0x01 : 0x00;
+	framebufferDirty = true;
 }
 
 void Core::opcodeE()
@@ -510,7 +1020,7 @@ void Core::opcodeE()
 
 void Core::opcodeEx9E()
 {
-	if (glfwGetKey(windowContext, KEY_MAP[registers[currRegX]]) == GLFW_PRESS)
+	if (keypad && keypad->isKeyPressed(registers[currRegX] & 0x0F))
 	{
 		programCounter += 2;
 	}
@@ -518,7 +1028,7 @@ void Core::opcodeEx9E()
 
 void Core::opcodeExA1()
 {
-	if (glfwGetKey(windowContext, KEY_MAP[registers[currRegX]]) == GLFW_RELEASE)
+	if (!(keypad && keypad->isKeyPressed(registers[currRegX] & 0x0F)))
 	{
 		programCounter += 2;
 	}
@@ -540,6 +1050,8 @@ void Core::opcodeFx0A()
 	// there's a much more accurate/faithful way to do this (https://retrocomputing.stackexchange.com/questions/358/how-are-held-down-keys-handled-in-chip-8)
 	// but i don't feel like implementing it right now
 	isWaitingForInput = true;
+	sliceInterrupted = true;
+	pendingRegister = currRegX;
 }
 
 void Core::opcodeFx15()
@@ -549,7 +1061,14 @@ void Core::opcodeFx15()
 
 void Core::opcodeFx18()
 {
+	bool wasEnabled = soundTimer > 0;
 	soundTimer = registers[currRegX];
+	if (audio && wasEnabled != (soundTimer > 0))
+	{
+		// cycleCount still points at the start of the slice here, so stop it and let run() report the edge
+		toneEdgePending = true;
+		sliceInterrupted = true;
+	}
 }
 
 void Core::opcodeFx1E()
@@ -566,9 +1085,9 @@ void Core::opcodeFx29()
 
 void Core::opcodeFx33()
 {
-	memory[indexRegister] = registers[currRegX] / 100;			 // 100s digit
-	memory[indexRegister + 1] = (registers[currRegX] / 10) % 10; //  10s digit
-	memory[indexRegister + 2] = registers[currRegX] % 10;		 //   1s digit
+	writeMemory(indexRegister, registers[currRegX] / 100);			   // 100s digit
+	writeMemory(indexRegister + 1, (registers[currRegX] / 10) % 10); //  10s digit
+	writeMemory(indexRegister + 2, registers[currRegX] % 10);		   //   1s digit
 }
 
 void Core::opcodeFx55()
@@ -577,7 +1096,7 @@ void Core::opcodeFx55()
 	// TODO: check if this is inclusive or exclusive
 	for (uint8_t i = 0x00; i < (currRegX + 1); i++)
 	{
-		memory[indexRegister + i] = registers[i];
+		writeMemory(indexRegister + i, registers[i]);
 	}
 }
 
@@ -587,7 +1106,7 @@ void Core::opcodeFx65()
 	// TODO: check if this is inclusive or exclusive
 	for (uint8_t i = 0x00; i < (currRegX + 1); i++)
 	{
-		registers[i] = memory[indexRegister + i];
+		registers[i] = memory[(indexRegister + i) & 0x0FFF];
 	}
 }
 
@@ -825,7 +1344,7 @@ void Core::opcodeFx65()
 	//		// TODO: check if this is inclusive or exclusive
 	//		for (uint8_t i = 0x00; i < (regX + 1); i++)
 	//		{
-	//			registers[i] = memory[indexRegister + i];
+	//			registers[i] = memory[(indexRegister + i) & 0x0FFF];
 	//		}
 	//		break;
 	//	}
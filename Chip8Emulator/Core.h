@@ -2,16 +2,51 @@
 
 #include <cstdint>
 #include <random>
+#include <memory>
+
+#include "Sinks.h"
+#include "Keypad.h"
+#include "Rom.h"
+#include "Jit.h"
+#include "Snapshot.h"
+#include "ForkedState.h"
+
+// which interpreter loop Core::run uses
+// all of them share the opcode handlers below, so they produce identical results
+enum class Dispatch
+{
+	Table,	 // two levels of member function pointer tables
+	Switch,	 // one big switch, lets the compiler inline the handlers
+	Threaded, // computed goto (GCC/Clang only, falls back to Switch elsewhere)
+	Cached,	  // predecoded instruction cache, one entry per even address
+	Jit		  // x86-64 basic block recompiler, interpreting whatever it can't translate
+};
+
+#if defined(__GNUC__)
+#define CHIP8_HAS_COMPUTED_GOTO
+#endif
 
-#include "Renderer.h"
-#include "OlcNoiseMaker.h"
-#include "Keys.h"
+// what Core::run left the core doing
+enum class RunState
+{
+	Running,
+	WaitingForKey // suspended on Fx0A, keyPressed() resumes it
+};
+
+#ifndef CHIP8_DEFAULT_DISPATCH
+#define CHIP8_DEFAULT_DISPATCH Dispatch::Table
+#endif
 
 class Core
 {
+	friend class LockstepEngine; // shares the fontset
+
 private:
 	static uint8_t fontset[80];
-	GLFWwindow* windowContext;
+	DisplaySink* display;
+	const Keypad* keypad;
+	AudioSink* audio;
+	const Rom* rom; // resident image that reset() copies back in, nullptr until loadProgram
 
 	uint8_t registers[16];
 	uint16_t indexRegister;
@@ -20,52 +55,126 @@ private:
 
 	uint8_t delayTimer;
 	uint8_t soundTimer;
-	double lastDelayTimerUpdate;
-	double lastSoundTimerUpdate;
 
 	uint16_t stack[16];
-	uint8_t framebuffer[32 * 8]; // 32 high x 64 wide bitmap
+	uint64_t framebuffer[32]; // one word per row, bit 63 is the leftmost pixel
 	uint8_t memory[4096];
 
-	std::default_random_engine* generator;
-	std::uniform_int_distribution<int>* distribution;
+	// std::minstd_rand by hand, same sequence (LockstepEngine still uses the real one)
+	// but the state is a plain word that a Snapshot can hold
+	uint32_t rngState;
+	uint32_t nextRandom();
 
-	Renderer* renderer;
-	void updateFramebuffer(uint8_t xPos, uint8_t yPos, uint8_t height);
-	bool isPixelDeactivated(uint8_t oldByte, uint8_t newByte);
-
-	olcNoiseMaker<short>* sound;
-	double soundCallback(int nChannels, double deltaTime);
+	void setSoundTimer(uint8_t value, uint64_t cycle);
 
 	bool isWaitingForInput;
+	bool sliceInterrupted; // set by Fx0A and Fx18 to make the dispatch loop return right after them
+	bool toneEdgePending;  // Fx18 turned the tone on or off, run() reports it once it knows the cycle
+	uint8_t pendingRegister; // where Fx0A will put the key
+	bool wrapSprites; // quirk: sprites running off an edge wrap around instead of being clipped
+	bool framebufferDirty; // set by 00E0/Dxyn, cleared when the display is handed the framebuffer
+
+	uint64_t cycleCount;	   // emulated time, advances even while blocked on Fx0A
+	uint64_t instructionCount; // instructions actually executed
+	void tickTimers();
+	void tickTimers(uint64_t ticks);
+
+	Dispatch dispatch;
+	uint32_t execute(uint32_t count); // runs up to count instructions, stopping early on Fx0A. returns how many ran
+	uint32_t executeTable(uint32_t count);
+	uint32_t executeSwitch(uint32_t count);
+	uint32_t executeThreaded(uint32_t count);
+	uint32_t executeCached(uint32_t count);
+	uint32_t executeJit(uint32_t count);
+
+	void writeMemory(uint16_t address, uint8_t value); // all stores to memory go through here to keep decodeCache and jit coherent, wraps at 4K
+
+	// the pages memory was last forked to or loaded from, and which ones have been written since (bit n = page n)
+	std::shared_ptr<const MemoryPage> forkPages[ForkedState::PAGE_COUNT];
+	uint16_t dirtyPages;
+
+	template <typename State> void saveRegisters(State& state) const;
+	template <typename State> void loadRegisters(const State& state);
+	void restorePage(size_t page, const uint8_t* source);
 
 public:
-	Core(GLFWwindow* context);
-	~Core();
-
-	void loadProgram();
+	static const int CYCLES_PER_SECOND = 600;
+	static const int CYCLES_PER_TIMER_TICK = CYCLES_PER_SECOND / 60;
+
+	// any of the sinks may be nullptr, in which case that part of the machine is simply not observed
+	Core(DisplaySink* display, const Keypad* keypad, AudioSink* audio); // any of these can be nullptr
+
+	// XORs a sprite into a 32 row framebuffer, returns true if any pixel got turned off
+	// the starting position always wraps, wrap decides whether the rest of the sprite wraps or is clipped at the edges
+	static bool updateFramebuffer(uint64_t* framebuffer, const uint8_t* sprite, uint8_t xPos, uint8_t yPos, uint8_t height, bool wrap);
+	// every address (fetches, I and the bytes after it) wraps at 4K. returns the sprite's rows in place, or copied into
+	// wrapped (at least height bytes) when they run off the end of memory
+	static const uint8_t* spriteAt(const uint8_t* memory, uint16_t address, uint8_t height, uint8_t* wrapped);
+
+	void loadProgram(const Rom& rom); // rom has to outlive the core. resets the machine with it in memory
+	void reset(); // back to power on with the resident ROM copied in again, dispatch, quirks and the RNG are left alone
+	void seed(uint32_t seed);
+	// copies the whole machine into/out of a caller owned snapshot, no allocation
+	// load leaves the core exactly as it was when saved, returns false (and changes nothing) if the snapshot is from another version
+	void save(Snapshot& snapshot) const;
+	bool load(const Snapshot& snapshot);
+	// copy-on-write version for search trees: only the memory pages written since the state this core was last loaded
+	// from (or forked to) are copied, the rest are shared with it. load returns false for a state fork never filled in
+	void fork(ForkedState& child);
+	bool load(const ForkedState& state);
 	void opcode();
-	void draw();
-	void updateDelayTimer(double currTime);
-	void updateSoundTimer(double currTime);
-	friend void Fx0AKeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
-
-	const bool getIsWaitingForInput() const;
+	// timers tick off emulated time, so this can be called as fast as the host allows
+	// while suspended on Fx0A the cycles are skipped in one step, the timers still count down
+	RunState run(uint32_t cycles);
+	void setDispatch(Dispatch dispatch);
+	void setSpriteWrapping(bool wrap);
+	void setAudio(AudioSink* audio); // nullptr detaches it, e.g. so a speculative run can't be heard
+	AudioSink* getAudio() const;
+	void draw(); // presents unconditionally
+	bool presentIfDirty(); // presents only if the framebuffer changed since the last present, returns whether it did
+	void keyPressed(uint8_t key); // resumes the core if it's waiting on Fx0A
+
+	bool getIsWaitingForInput() const;
+	uint8_t getPendingRegister() const;
+	// suspended with both timers at zero, so nothing can change until a key arrives and the host can sleep
+	bool getIsIdle() const;
+	uint64_t getCycleCount() const;
+	uint64_t getInstructionCount() const;
+	const uint64_t* getFramebuffer() const;
+	bool getIsFramebufferDirty() const;
+	uint64_t stateHash() const; // FNV-1a over the whole machine state, for comparing runs
+	static uint64_t hashState(const uint8_t* registers, uint16_t indexRegister, uint16_t programCounter, int8_t stackPointer,
+		uint8_t delayTimer, uint8_t soundTimer, const uint16_t* stack, const uint64_t* framebuffer, const uint8_t* memory);
 
 	void log();
 	
 private:
 	typedef void (Core::* Opcode)();
-	Opcode opcodeTable[16];
-	Opcode subtable0[256];
-	Opcode subtable8[16];
-	Opcode subtableE[256];
-	Opcode subtableF[256];
+	// shared by every instance, filled in by the first constructor
+	static Opcode opcodeTable[16];
+	static Opcode subtable0[256];
+	static Opcode subtable8[16];
+	static Opcode subtableE[256];
+	static Opcode subtableF[256];
+	static void initTables();
 
 	uint16_t currOpcode;
 	uint8_t currRegX;
 	uint8_t currRegY;
 
+	struct DecodedInstruction
+	{
+		Opcode handler; // leaf handler (subtables already resolved), nullptr if not decoded yet
+		uint16_t opcode;
+		uint8_t regX;
+		uint8_t regY;
+	};
+	std::unique_ptr<DecodedInstruction[]> decodeCache; // only allocated once the Cached engine is used
+	void decode(uint16_t address, DecodedInstruction& entry);
+	void invalidateDecodeCache();
+
+	std::unique_ptr<::Jit> jit; // only allocated once the Jit engine is used
+
 	void noOperation();
 
 	void opcode0();
@@ -112,23 +221,3 @@ private:
 	void opcodeFx55();
 	void opcodeFx65();
 };
-
-// so gross but hey what can you do
-inline void Fx0AKeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
-{
-	Core* c = static_cast<Core*>(glfwGetWindowUserPointer(window));
-
-	if (!c->isWaitingForInput) return;
-
-	for (int i = 0; i < 16; i++)
-	{
-		if (key == KEY_MAP[i] && action == GLFW_PRESS)
-		{
-			uint16_t opcode = c->memory[c->programCounter - 2] << 8 | c->memory[c->programCounter - 1]; // pc will be one instruction ahead during this
-			int regX = (opcode & 0x0F00) >> 8;
-			c->registers[regX] = i;
-			c->isWaitingForInput = false;
-			return;
-		}
-	}
-}
\ No newline at end of file
@@ -0,0 +1,176 @@
+#include <cstring>
+
+#include "EmulationThread.h"
+#include "FrameClock.h"
+
+EmulationThread::EmulationThread(Core& core, Keypad& keypad, bool maxSpeed, RewindBuffer* rewind, InputLog* inputLog)
+	: m_core(core), m_keypad(keypad), m_maxSpeed(maxSpeed), m_running(false), m_pendingWake(false), m_rewind(inputLog ? nullptr : rewind),
+	m_inputLog(inputLog), m_rewinding(false), m_runAheadTicks(0), m_runTime(0)
+{
+	memset(m_runAheadFrame, 0, sizeof(m_runAheadFrame));
+}
+
+EmulationThread::~EmulationThread()
+{
+	stop();
+}
+
+void EmulationThread::start()
+{
+	m_running = true;
+	m_thread = std::thread(&EmulationThread::run, this);
+}
+
+void EmulationThread::stop()
+{
+	if (!m_thread.joinable()) return;
+
+	m_running = false;
+	wake();
+	m_thread.join();
+}
+
+void EmulationThread::postKeyEvent(const KeyEvent& event)
+{
+	// a dropped key up would leave the key held (and the input log out of step with the window), so if the queue is full
+	// keep the emulation thread awake until it has drained some. it pops at least once per batch, so this is short
+	while (!m_keyEvents.push(event))
+	{
+		if (!m_running) return; // nobody left to drain it
+		wake();
+		std::this_thread::yield();
+	}
+	wake();
+}
+
+void EmulationThread::setRewinding(bool rewinding)
+{
+	m_rewinding = rewinding;
+	wake(); // a core parked on Fx0A can still be rewound
+}
+
+void EmulationThread::setRunAhead(uint32_t ticks)
+{
+	m_runAheadTicks = ticks;
+}
+
+void EmulationThread::wake()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pendingWake = true;
+	}
+	m_wake.notify_one();
+}
+
+void EmulationThread::record()
+{
+	if (!m_rewind) return;
+	m_core.save(m_snapshot);
+	m_rewind->push(m_snapshot);
+}
+
+void EmulationThread::rewind(uint32_t ticks)
+{
+	for (uint32_t i = 0; i < ticks; i++)
+	{
+		if (!m_rewind->stepBack(m_snapshot)) break; // at the oldest state kept, stay there
+		m_core.load(m_snapshot);
+	}
+	present();
+}
+
+void EmulationThread::present()
+{
+	if (m_runAheadTicks == 0)
+	{
+		m_core.presentIfDirty();
+		return;
+	}
+
+	// the speculative ticks never reach the audio sink, it only hears the real timeline
+	// load puts back the exact state (RNG included) so the real run carries on as if this never happened
+	AudioSink* audio = m_core.getAudio();
+	m_core.setAudio(nullptr);
+	m_core.save(m_runAheadState);
+	m_core.run(m_runAheadTicks * Core::CYCLES_PER_TIMER_TICK);
+	// the dirty flag can't tell whether this differs from the last speculative frame, so compare them
+	if (memcmp(m_runAheadFrame, m_core.getFramebuffer(), sizeof(m_runAheadFrame)) != 0)
+	{
+		memcpy(m_runAheadFrame, m_core.getFramebuffer(), sizeof(m_runAheadFrame));
+		m_core.draw();
+	}
+	m_core.load(m_runAheadState);
+	m_core.setAudio(audio);
+}
+
+std::chrono::steady_clock::duration EmulationThread::getRunTime() const
+{
+	return m_runTime;
+}
+
+void EmulationThread::sleepFor(int64_t timeout)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (timeout < 0)
+		m_wake.wait(lock, [this]() { return m_pendingWake; });
+	else
+		m_wake.wait_for(lock, std::chrono::nanoseconds(timeout), [this]() { return m_pendingWake; });
+	m_pendingWake = false;
+}
+
+void EmulationThread::run()
+{
+	// one tick = one timer tick's worth of instructions, then a present if anything was drawn
+	FrameClock clock(Core::CYCLES_PER_SECOND / Core::CYCLES_PER_TIMER_TICK);
+	auto startTime = std::chrono::steady_clock::now();
+	record(); // the starting state, so rewinding can get all the way back to it
+
+	while (m_running)
+	{
+		KeyEvent event;
+		while (m_keyEvents.pop(event))
+		{
+			m_keypad.apply(event);
+			if (event.pressed) m_core.keyPressed(event.key);
+			if (m_inputLog) m_inputLog->record(m_core, event);
+		}
+
+		if (m_maxSpeed)
+		{
+			m_core.run(MAX_SPEED_BATCH);
+			if (clock.takeDueTicks() > 0) m_core.presentIfDirty();
+			if (m_core.getIsIdle())
+			{
+				m_core.presentIfDirty();
+				sleepFor(-1);
+			}
+			continue;
+		}
+
+		bool rewinding = m_rewind && m_rewinding;
+		if (m_core.getIsIdle() && !rewinding)
+		{
+			// parked on Fx0A with nothing counting down, sleep until a key arrives
+			sleepFor(-1);
+			clock.reset();
+			continue;
+		}
+
+		uint32_t due = clock.takeDueTicks();
+		if (due > 0 && rewinding)
+		{
+			rewind(due);
+		}
+		else if (due > 0)
+		{
+			m_core.run(due * Core::CYCLES_PER_TIMER_TICK);
+			record();
+			present();
+		}
+
+		sleepFor(clock.getTimeUntilNextTick());
+	}
+
+	m_runTime = std::chrono::steady_clock::now() - startTime;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include "Core.h"
+#include "Keypad.h"
+#include "SpscQueue.h"
+#include "RewindBuffer.h"
+#include "InputLog.h"
+
+// Runs a Core on its own thread, paced to native speed by a FrameClock (or uncapped).
+// Frames leave through the Core's DisplaySink (a FrameExchange in the windowed build) and key presses come in through
+// an SPSC queue, so a slow swap or a stalled window thread can't hold up instruction execution.
+// The keypad is only updated here, between run() calls, so every key change lands on a known cycle and can be logged
+// to an InputLog and replayed exactly.
+// At native speed the state after every tick goes into a RewindBuffer, and while rewinding is held each tick steps the
+// Core back one of those states instead of running it.
+// With run-ahead on, every tick also runs the Core a few ticks further with the current input, presents that, and
+// snapshots back, so a key press shows up on screen as soon as the ROM would react to it.
+// Nothing else may touch the Core between start() and stop().
+class EmulationThread
+{
+private:
+	Core& m_core;
+	Keypad& m_keypad;
+	bool m_maxSpeed;
+	std::thread m_thread;
+	std::atomic<bool> m_running;
+	SpscQueue<KeyEvent, 64> m_keyEvents;
+
+	// only used to sleep, never held while emulating
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	bool m_pendingWake;
+
+	RewindBuffer* m_rewind; // nullptr = no history kept
+	InputLog* m_inputLog;	// nullptr = not recording
+	std::atomic<bool> m_rewinding;
+	Snapshot m_snapshot;
+	uint32_t m_runAheadTicks;
+	Snapshot m_runAheadState;
+	uint64_t m_runAheadFrame[32]; // last speculative frame presented
+
+	std::chrono::steady_clock::duration m_runTime;
+
+	void run();
+	void sleepFor(int64_t timeout); // nanoseconds, returns early on a key event or stop(). negative = until woken
+	void wake();
+	void record();
+	void rewind(uint32_t ticks);
+	void present(); // the real state, or what it'll look like in m_runAheadTicks ticks
+
+public:
+	// cycles run between checks for key events when uncapped, headless uncapped runs use the same slices
+	static const uint32_t MAX_SPEED_BATCH = 100000;
+
+	// rewinding and recording can't be combined, a log has no way to express going back in time
+	EmulationThread(Core& core, Keypad& keypad, bool maxSpeed, RewindBuffer* rewind = nullptr, InputLog* inputLog = nullptr);
+	~EmulationThread();
+
+	void start();
+	void stop(); // joins
+
+	// called from the window thread, the event reaches the keypad (and resumes Fx0A) before the next run
+	void postKeyEvent(const KeyEvent& event);
+	void setRewinding(bool rewinding); // window thread, held down = keep stepping back one tick per tick
+	void setRunAhead(uint32_t ticks); // before start(), 0 = off. only used at native speed
+
+	std::chrono::steady_clock::duration getRunTime() const; // valid after stop()
+};
@@ -0,0 +1,257 @@
+#include <iostream>
+#include <algorithm>
+#include <random>
+
+#include "EngineCheck.h"
+#include "LockstepEngine.h"
+
+namespace
+{
+	const uint64_t CASE_CYCLES = Core::CYCLES_PER_SECOND * 20;
+
+	const Dispatch MODES[] = { Dispatch::Table, Dispatch::Switch, Dispatch::Threaded, Dispatch::Cached, Dispatch::Jit };
+	const char* const MODE_NAMES[] = { "table", "switch", "threaded", "cached", "jit" };
+	const size_t MODE_COUNT = sizeof(MODES) / sizeof(MODES[0]);
+	const size_t LOCKSTEP_LANES = 8; // each with its own seed and input, so they split up and regroup
+
+	std::shared_ptr<const Rom> assemble(const std::vector<uint16_t>& opcodes)
+	{
+		std::vector<uint8_t> bytes;
+		for (size_t i = 0; i < opcodes.size(); i++)
+		{
+			bytes.push_back(opcodes[i] >> 8);
+			bytes.push_back(opcodes[i] & 0xFF);
+		}
+		std::shared_ptr<Rom> rom = std::make_shared<Rom>();
+		rom->assign(bytes.data(), bytes.size());
+		return rom;
+	}
+
+	// only ever valid opcodes, so nothing gets reported as invalid while it runs. stores only go through I while it
+	// points at the font or the data area at 0xE00, the code itself is never overwritten
+	std::vector<uint16_t> randomProgram(uint32_t seed)
+	{
+		const int STATEMENTS = 200;
+		const uint16_t ALU[] = { 0x0, 0x1, 0x2, 0x3, 0x4, 0x5, 0x6, 0x7, 0xE };
+		const uint16_t TIMERS_AND_MEMORY[] = { 0x07, 0x15, 0x18, 0x33, 0x55, 0x65 };
+
+		std::minstd_rand random(seed);
+		std::vector<uint16_t> program;
+		for (int i = 0; i < STATEMENTS; i++)
+		{
+			uint16_t x = random() % 15 << 8;
+			uint16_t y = random() % 16 << 4;
+			uint16_t kk = random() % 256;
+			uint16_t data = 0xE00 + random() % 0xF0;
+
+			switch (random() % 24)
+			{
+			case 0: case 1: case 2: program.push_back(0x6000 | x | kk); break;
+			case 3: case 4: case 5: program.push_back(0x7000 | x | kk); break;
+			case 6: case 7: case 8: case 9: program.push_back(0x8000 | x | y | ALU[random() % 9]); break;
+			case 10: program.push_back(0x8F00 | y | ALU[4 + random() % 5]); break; // the flag is also the destination
+			case 11: program.push_back((random() % 2 ? 0x3000 : 0x4000) | x | kk); break;
+			case 12: program.push_back((random() % 2 ? 0x5000 : 0x9000) | x | y); break;
+			case 13: program.push_back(0xA000 | data); break;
+			case 14: program.push_back(0xF000 | x | TIMERS_AND_MEMORY[random() % 6]); break;
+			case 15: program.push_back(0xC000 | x | kk); break;
+			case 16: program.push_back(0xA000 | random() % 80); break;
+			case 17: program.push_back(0x1200 + 2 * (random() % STATEMENTS)); break;
+			case 18: program.push_back(0xF01E | x); program.push_back(0xA000 | data); break;
+			case 19: program.push_back(0xD000 | x | y | (1 + random() % 15)); break;
+			case 20: program.push_back((random() % 2 ? 0xE09E : 0xE0A1) | x); break;
+			case 21: program.push_back(random() % 8 ? 0xF01E | x : 0xF00A | x); program.push_back(0xA000 | data); break;
+			case 22: program.push_back(0xF029 | x); break;
+			case 23: program.push_back(0x00E0); break;
+			}
+		}
+		program.push_back(0x1200);
+		return program;
+	}
+
+	void addCase(std::vector<EngineCheckCase>& cases, const std::string& name, const std::vector<uint16_t>& program, uint32_t seed, bool wrapSprites)
+	{
+		EngineCheckCase entry = EngineCheck::romCase(name, assemble(program));
+		entry.job.seed = seed;
+		entry.job.input = EngineCheck::scriptedInput(entry.job.cycles, seed);
+		entry.job.wrapSprites = wrapSprites;
+		cases.push_back(entry);
+	}
+
+	// lane n runs the case's program with seed + n and its own input, so every lane but the first diverges
+	BatchJob laneJob(const BatchJob& job, size_t lane)
+	{
+		BatchJob result = job;
+		if (lane > 0)
+		{
+			result.seed = job.seed + static_cast<uint32_t>(lane);
+			result.input = EngineCheck::scriptedInput(job.cycles, result.seed);
+		}
+		return result;
+	}
+
+	// same input handling as BatchRunner::runJob, so every lane should end exactly where a Core running its job does
+	bool checkLockstep(const EngineCheckCase& testCase)
+	{
+		const BatchJob& job = testCase.job;
+		LockstepEngine engine(LOCKSTEP_LANES);
+		engine.setSpriteWrapping(job.wrapSprites);
+		if (job.program) engine.loadProgram(job.program->getData(), job.program->getSize());
+
+		std::vector<BatchJob> jobs;
+		std::vector<size_t> next(LOCKSTEP_LANES, 0);
+		std::vector<uint16_t> held(LOCKSTEP_LANES, 0);
+		for (size_t lane = 0; lane < LOCKSTEP_LANES; lane++)
+		{
+			jobs.push_back(laneJob(job, lane));
+			engine.seed(lane, jobs[lane].seed);
+		}
+
+		for (;;)
+		{
+			uint64_t until = job.cycles;
+			for (size_t lane = 0; lane < LOCKSTEP_LANES; lane++)
+			{
+				if (next[lane] < jobs[lane].input.size()) until = std::min(until, jobs[lane].input[next[lane]].cycle);
+			}
+			while (engine.getCycleCount() < until)
+			{
+				uint64_t remaining = until - engine.getCycleCount();
+				engine.run(static_cast<uint32_t>(remaining < 0x10000000 ? remaining : 0x10000000));
+			}
+			if (until == job.cycles) break;
+
+			for (size_t lane = 0; lane < LOCKSTEP_LANES; lane++)
+			{
+				for (; next[lane] < jobs[lane].input.size() && jobs[lane].input[next[lane]].cycle == until; next[lane]++)
+				{
+					uint16_t keys = jobs[lane].input[next[lane]].keys;
+					uint16_t pressed = keys & ~held[lane];
+					held[lane] = keys;
+					engine.setKeys(lane, keys);
+					for (uint8_t key = 0; key < 16; key++)
+					{
+						if ((pressed >> key) & 0x01)
+						{
+							engine.keyPressed(lane, key);
+							break;
+						}
+					}
+				}
+			}
+		}
+
+		bool agree = true;
+		for (size_t lane = 0; lane < LOCKSTEP_LANES; lane++)
+		{
+			BatchResult reference;
+			BatchRunner::runJob(jobs[lane], MODES[0], reference);
+			if (engine.stateHash(lane) != reference.stateHash)
+			{
+				std::cerr << testCase.name << ": lockstep lane " << lane << " ended in state " << std::hex << engine.stateHash(lane)
+					<< ", " << MODE_NAMES[0] << " in " << reference.stateHash << std::dec << std::endl;
+				agree = false;
+			}
+		}
+		return agree;
+	}
+}
+
+std::vector<EngineCheckCase> EngineCheck::builtInCases()
+{
+	std::vector<EngineCheckCase> cases;
+
+	for (uint32_t seed = 1; seed <= 8; seed++)
+	{
+		addCase(cases, "random " + std::to_string(seed), randomProgram(seed), seed, seed % 2 == 0);
+	}
+
+	// counts, BCD, font draws, a subroutine that plays with the timers, looping forever
+	addCase(cases, "subroutines", {
+		0x6000, 0x6105, 0x6A00, 0x6B00,
+		0x7001, 0x8014, 0x8216, 0x8305, 0x830E, 0x8407, 0xC5FF, 0xA300, 0xF033, 0xF265, 0xF029, 0xDAB5,
+		0x7A05, 0x3A3C, 0x1208, 0x6A00, 0x7B06, 0x6C0F, 0x8BC2, 0x2232, 0x1208,
+		0xF615, 0xF707, 0xF818, 0x8A70, 0x8AA3, 0x6A00, 0x00EE
+	}, 3, false);
+
+	// Fx55 rewrites the 63xx at 0x20A every time round, so a cached decode or a compiled block has to notice
+	addCase(cases, "self-modifying", { 0xA20A, 0x6063, 0x7101, 0xF155, 0x6300, 0x0000, 0x8434, 0x1204 }, 4, false);
+
+	// recursion 0 to 31 deep: past 16 the stack index wraps and overwrites the oldest return addresses, and if that
+	// happened the returns carry on past the bottom, taking the stack pointer through every value
+	addCase(cases, "stack edges", {
+		0x6000, 0xC11F, 0x2208, 0x1200,
+		0x7001, 0x5010, 0x2208, 0x00EE
+	}, 6, false);
+
+	// addresses past 0xFFF wrap to the bottom of memory: jumps through an instruction split across 0xFFF/0x000 and one
+	// at 0x1002 (fetched from 0x002), then stores, loads, BCD and a sprite from I = 0xFFE
+	addCase(cases, "memory edges", {
+		0x6012, 0x610E, 0xAFFF, 0xF155, 0x6000, 0xBFFF, 0x00E0,
+		0x6012, 0x611A, 0xA002, 0xF155, 0x6003, 0xBFFF,
+		0x6F7B, 0xAFFE, 0xFF55, 0xFF65, 0xFF33, 0xD01F, 0x1200
+	}, 5, true);
+
+	return cases;
+}
+
+EngineCheckCase EngineCheck::romCase(const std::string& name, std::shared_ptr<const Rom> program)
+{
+	EngineCheckCase entry;
+	entry.name = name;
+	entry.job.program = program;
+	entry.job.seed = 1;
+	entry.job.cycles = CASE_CYCLES;
+	entry.job.input = scriptedInput(CASE_CYCLES, 1);
+	return entry;
+}
+
+std::vector<InputEvent> EngineCheck::scriptedInput(uint64_t cycles, uint32_t seed)
+{
+	std::minstd_rand random(seed);
+	std::vector<InputEvent> input;
+	uint64_t cycle = 0;
+	for (;;)
+	{
+		cycle += Core::CYCLES_PER_TIMER_TICK + random() % (Core::CYCLES_PER_TIMER_TICK * 6);
+		if (cycle >= cycles) break;
+
+		// mostly one or two keys, sometimes none
+		uint16_t keys = static_cast<uint16_t>(1 << (random() % 16));
+		if (random() % 3 == 0) keys |= 1 << (random() % 16);
+		if (random() % 4 == 0) keys = 0;
+		InputEvent event = { cycle, keys };
+		input.push_back(event);
+	}
+	return input;
+}
+
+bool EngineCheck::run(const std::vector<EngineCheckCase>& cases)
+{
+	bool allAgree = true;
+	for (size_t i = 0; i < cases.size(); i++)
+	{
+		BatchResult reference;
+		BatchRunner::runJob(cases[i].job, MODES[0], reference);
+
+		bool agree = true;
+		for (size_t mode = 1; mode < MODE_COUNT; mode++)
+		{
+			BatchResult result;
+			BatchRunner::runJob(cases[i].job, MODES[mode], result);
+			if (result.stateHash != reference.stateHash || result.instructionCount != reference.instructionCount)
+			{
+				std::cerr << cases[i].name << ": " << MODE_NAMES[mode] << " ended in state " << std::hex << result.stateHash
+					<< std::dec << " after " << result.instructionCount << " instructions, " << MODE_NAMES[0] << " in "
+					<< std::hex << reference.stateHash << std::dec << " after " << reference.instructionCount << std::endl;
+				agree = false;
+			}
+		}
+		agree = checkLockstep(cases[i]) && agree;
+
+		std::cout << cases[i].name << ": " << (agree ? "ok" : "MISMATCH") << " (" << std::hex << reference.stateHash << std::dec
+			<< ", " << reference.instructionCount << " instructions)" << std::endl;
+		allAgree = allAgree && agree;
+	}
+	return allAgree;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "BatchRunner.h"
+
+struct EngineCheckCase
+{
+	std::string name;
+	BatchJob job; // fixed seed and scripted input, so every run of it is the same
+};
+
+// Runs programs headless through every Dispatch mode and compares the states they end in.
+// The modes share the opcode handlers but each has its own fetch, caching and invalidation, so this is what catches
+// one of them drifting from the table interpreter. LockstepEngine has handlers of its own, so it runs each program over
+// a few lanes with different seeds and input and every lane is compared with a Core given the same ones.
+// Deterministic and quick, the build runs it (--verify-engines) after linking and fails if anything disagrees.
+class EngineCheck
+{
+public:
+	// generated programs that between them cover every opcode, key input, self-modifying code, addresses that wrap at
+	// the top of memory and stack overflow and underflow
+	static std::vector<EngineCheckCase> builtInCases();
+	static EngineCheckCase romCase(const std::string& name, std::shared_ptr<const Rom> program);
+
+	// a new set of held keys every few ticks, decided by seed
+	static std::vector<InputEvent> scriptedInput(uint64_t cycles, uint32_t seed);
+
+	// prints a line per case, returns false if any mode or lane ended up anywhere other than where Dispatch::Table did
+	static bool run(const std::vector<EngineCheckCase>& cases);
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+// one slice of the 4K address space, shared between every state that hasn't written to it
+struct MemoryPage
+{
+	static const size_t SIZE = 256;
+	uint8_t bytes[SIZE];
+};
+
+// A machine state for search trees, made by Core::fork and resumed with Core::load.
+// Registers, stack, timers and the framebuffer are copied outright, they're only a few hundred bytes. Memory is
+// 16 immutable pages held by reference: a fork only copies the pages the core wrote (through Fx33/Fx55) since the state
+// it was loaded from, every other page is shared with the parent, so a node costs about a kilobyte instead of 4K+.
+// Pages are reference counted, nodes can be handed between threads and freed in any order.
+struct ForkedState
+{
+	static const size_t PAGE_COUNT = 4096 / MemoryPage::SIZE;
+
+	uint64_t cycleCount;
+	uint64_t instructionCount;
+	uint64_t framebuffer[32];
+
+	uint32_t rngState;
+	uint16_t indexRegister;
+	uint16_t programCounter;
+	uint16_t stack[16];
+
+	uint8_t registers[16];
+	int8_t stackPointer;
+	uint8_t delayTimer;
+	uint8_t soundTimer;
+	uint8_t isWaitingForInput;
+	uint8_t pendingRegister;
+
+	std::shared_ptr<const MemoryPage> pages[PAGE_COUNT]; // all set by fork, a default constructed state can't be loaded
+};
@@ -0,0 +1,65 @@
+#include <chrono>
+#include <thread>
+
+#include "FrameClock.h"
+
+FrameClock::FrameClock(uint32_t ticksPerSecond)
+	: m_ticksPerSecond(ticksPerSecond), m_start(now()), m_ticksTaken(0)
+{
+}
+
+int64_t FrameClock::now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int64_t FrameClock::deadline(uint64_t tick) const
+{
+	// split so tick * NANOSECONDS_PER_SECOND can't overflow over long runs
+	uint64_t seconds = tick / m_ticksPerSecond;
+	uint64_t remainder = tick % m_ticksPerSecond;
+	return m_start + static_cast<int64_t>(seconds) * NANOSECONDS_PER_SECOND
+		+ static_cast<int64_t>(remainder * NANOSECONDS_PER_SECOND / m_ticksPerSecond);
+}
+
+uint32_t FrameClock::takeDueTicks()
+{
+	int64_t currTime = now();
+	uint32_t due = 0;
+	while (due < MAX_CATCH_UP_TICKS && deadline(m_ticksTaken + 1) <= currTime)
+	{
+		m_ticksTaken++;
+		due++;
+	}
+
+	if (deadline(m_ticksTaken + 1) <= currTime)
+	{
+		// still behind, restart the timeline from here rather than trying to catch up
+		m_start = currTime;
+		m_ticksTaken = 0;
+	}
+	return due;
+}
+
+void FrameClock::reset()
+{
+	m_start = now();
+	m_ticksTaken = 0;
+}
+
+int64_t FrameClock::getTimeUntilNextTick() const
+{
+	int64_t remaining = deadline(m_ticksTaken + 1) - now();
+	return (remaining > 0) ? remaining : 0;
+}
+
+double FrameClock::getSecondsUntilNextTick() const
+{
+	return static_cast<double>(getTimeUntilNextTick()) / NANOSECONDS_PER_SECOND;
+}
+
+void FrameClock::sleepUntilNextTick() const
+{
+	int64_t remaining = getTimeUntilNextTick();
+	if (remaining > 0) std::this_thread::sleep_for(std::chrono::nanoseconds(remaining));
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+
+// Fixed rate deadline clock on an integer nanosecond timeline.
+// Tick n is due at start + n * 1s / rate, computed from the tick count rather than accumulated, so ticks never
+// drift no matter how late the host wakes up. The host runs whatever work the due ticks need, then sleeps
+// (or waits on window events) until getTimeUntilNextTick().
+class FrameClock
+{
+public:
+	static const int64_t NANOSECONDS_PER_SECOND = 1000000000;
+
+	FrameClock(uint32_t ticksPerSecond);
+
+	static int64_t now(); // steady clock, in nanoseconds
+
+	// returns how many ticks became due since the last call
+	// if the host fell far behind (debugger, window drag) the backlog is dropped instead of run in one go
+	uint32_t takeDueTicks();
+	void reset(); // restarts the timeline from now, e.g. after the host slept through a suspended core
+
+	int64_t getTimeUntilNextTick() const; // nanoseconds, 0 if a tick is already due
+	double getSecondsUntilNextTick() const;
+	void sleepUntilNextTick() const; // for hosts without an event loop to block in
+
+private:
+	static const uint32_t MAX_CATCH_UP_TICKS = 6;
+
+	uint32_t m_ticksPerSecond;
+	int64_t m_start;
+	uint64_t m_ticksTaken;
+
+	int64_t deadline(uint64_t tick) const;
+};
@@ -0,0 +1,64 @@
+#include <cstring>
+#include <chrono>
+
+#include "FrameExchange.h"
+
+FrameExchange::FrameExchange()
+	: m_middle(1), m_back(0), m_front(2), m_consumerWaiting(false), m_woken(false)
+{
+	memset(m_frames, 0, sizeof(m_frames));
+}
+
+void FrameExchange::present(const uint64_t* framebuffer)
+{
+	memcpy(m_frames[m_back], framebuffer, sizeof(m_frames[m_back]));
+	uint8_t previous = m_middle.exchange(m_back | FRESH, std::memory_order_seq_cst);
+	m_back = previous & 0x03;
+
+	// most frames nobody is asleep, so skip the mutex entirely. both sides are seq_cst: either the consumer's check
+	// sees FRESH or this sees m_consumerWaiting, and taking the lock after the swap means a consumer about to sleep
+	// then either sees FRESH or gets the notify
+	if (!m_consumerWaiting.load(std::memory_order_seq_cst)) return;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+	}
+	m_published.notify_one();
+}
+
+bool FrameExchange::acquire()
+{
+	if (!(m_middle.load(std::memory_order_acquire) & FRESH)) return false;
+
+	uint8_t previous = m_middle.exchange(m_front, std::memory_order_acq_rel);
+	m_front = previous & 0x03;
+	return true;
+}
+
+const uint64_t* FrameExchange::getFrame() const
+{
+	return m_frames[m_front];
+}
+
+bool FrameExchange::waitForFrame(int64_t timeout)
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_consumerWaiting.store(true, std::memory_order_seq_cst);
+		m_published.wait_for(lock, std::chrono::nanoseconds(timeout), [this]()
+		{
+			return m_woken || (m_middle.load(std::memory_order_seq_cst) & FRESH);
+		});
+		m_consumerWaiting.store(false, std::memory_order_relaxed);
+		m_woken = false;
+	}
+	return acquire();
+}
+
+void FrameExchange::wake()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_woken = true;
+	}
+	m_published.notify_one();
+}
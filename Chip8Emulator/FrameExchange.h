@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+#include "Sinks.h"
+
+// Hands finished frames from the emulation thread to the render thread.
+// Triple buffered: the producer always has a back buffer to write into and the consumer always has a front buffer to
+// draw from, and the two only meet on one atomic swap of the middle buffer, so neither side ever waits for the other.
+// The condition variable is only there so an idle render thread can sleep until the next frame arrives, and the
+// producer only touches it when the consumer says it's waiting.
+class FrameExchange : public DisplaySink
+{
+private:
+	static const uint8_t FRESH = 0x04; // set in m_middle when it holds a frame the consumer hasn't taken yet
+
+	uint64_t m_frames[3][32];
+	std::atomic<uint8_t> m_middle; // index of the middle buffer, plus FRESH
+	uint8_t m_back;	 // producer only
+	uint8_t m_front; // consumer only
+
+	std::atomic<bool> m_consumerWaiting; // set while waitForFrame may be asleep, present() only notifies then
+
+	std::mutex m_mutex;
+	std::condition_variable m_published;
+	bool m_woken;
+
+public:
+	FrameExchange();
+
+	// producer side, copies the framebuffer into the back buffer and publishes it
+	void present(const uint64_t* framebuffer) override;
+
+	// consumer side. returns true if a newer frame was published since the last call, getFrame() then returns it
+	bool acquire();
+	const uint64_t* getFrame() const;
+
+	// sleeps until a frame is published, wake() is called or timeout (nanoseconds) passes, then acquire()s
+	bool waitForFrame(int64_t timeout);
+	void wake();
+};
@@ -0,0 +1,20 @@
+#include "GlfwSinks.h"
+
+GlfwDisplay::GlfwDisplay(GLFWwindow* window, RenderMode mode)
+	: m_window(window)
+{
+	m_renderer = new Renderer(mode);
+}
+
+GlfwDisplay::~GlfwDisplay()
+{
+	delete m_renderer;
+}
+
+void GlfwDisplay::present(const uint64_t* framebuffer)
+{
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+	m_renderer->draw(framebuffer, 32, 64);
+	glfwSwapBuffers(m_window);
+}
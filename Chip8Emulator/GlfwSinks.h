@@ -0,0 +1,22 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "Sinks.h"
+#include "Renderer.h"
+
+// windowed implementation of the Core's display sink, input comes in through a GLFW key callback in main
+
+class GlfwDisplay : public DisplaySink
+{
+private:
+	GLFWwindow* m_window;
+	Renderer* m_renderer;
+
+public:
+	GlfwDisplay(GLFWwindow* window, RenderMode mode = RenderMode::Texture);
+	~GlfwDisplay();
+
+	void present(const uint64_t* framebuffer) override;
+};
@@ -0,0 +1,205 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "InputLog.h"
+
+namespace
+{
+	void runUntil(Core& core, uint64_t cycle)
+	{
+		while (core.getCycleCount() < cycle)
+		{
+			uint64_t remaining = cycle - core.getCycleCount();
+			core.run(static_cast<uint32_t>(remaining < 0x10000000 ? remaining : 0x10000000));
+		}
+	}
+}
+
+InputLog::InputLog()
+	: m_romHash(0), m_seed(0), m_wrapSprites(false), m_ended(false), m_endCycle(0), m_endInstructionCount(0), m_endStateHash(0)
+{
+}
+
+void InputLog::begin(const Rom& rom, uint32_t seed, bool wrapSprites)
+{
+	m_romHash = hashRom(rom);
+	m_seed = seed;
+	m_wrapSprites = wrapSprites;
+	m_events.clear();
+	m_ended = false;
+}
+
+void InputLog::record(const Core& core, const KeyEvent& event)
+{
+	InputLogEvent entry = { core.getCycleCount(), core.getInstructionCount(), static_cast<uint8_t>(event.key & 0x0F), event.pressed };
+	m_events.push_back(entry);
+}
+
+void InputLog::end(const Core& core)
+{
+	m_ended = true;
+	m_endCycle = core.getCycleCount();
+	m_endInstructionCount = core.getInstructionCount();
+	m_endStateHash = core.stateHash();
+}
+
+bool InputLog::save(const char* path) const
+{
+	std::ofstream file(path);
+	if (!file.is_open()) return false;
+
+	file << "chip8-input-log " << VERSION << "\n";
+	file << std::hex << "rom " << m_romHash << std::dec << "\n";
+	file << "seed " << m_seed << "\n";
+	file << "wrap " << (m_wrapSprites ? 1 : 0) << "\n";
+	for (size_t i = 0; i < m_events.size(); i++)
+	{
+		const InputLogEvent& event = m_events[i];
+		file << "key " << event.cycle << " " << event.instructionCount << " " << std::hex << static_cast<int>(event.key) << std::dec
+			<< (event.pressed ? " down" : " up") << "\n";
+	}
+	if (m_ended)
+	{
+		file << "end " << m_endCycle << " " << m_endInstructionCount << " " << std::hex << m_endStateHash << std::dec << "\n";
+	}
+	return static_cast<bool>(file);
+}
+
+bool InputLog::load(const char* path)
+{
+	std::ifstream file(path);
+	if (!file.is_open()) return false;
+
+	*this = InputLog();
+
+	std::string line;
+	int lineNumber = 0;
+	bool sawHeader = false;
+	while (std::getline(file, line))
+	{
+		lineNumber++;
+
+		size_t comment = line.find('#');
+		if (comment != std::string::npos) line.erase(comment);
+
+		std::istringstream fields(line);
+		std::string type;
+		if (!(fields >> type)) continue; // blank line
+
+		bool ok = false;
+		if (!sawHeader)
+		{
+			int version = 0;
+			ok = type == "chip8-input-log" && (fields >> version) && version == VERSION;
+			sawHeader = ok;
+		}
+		else if (type == "rom")
+		{
+			ok = static_cast<bool>(fields >> std::hex >> m_romHash);
+		}
+		else if (type == "seed")
+		{
+			ok = static_cast<bool>(fields >> m_seed);
+		}
+		else if (type == "wrap")
+		{
+			int wrap = 0;
+			ok = static_cast<bool>(fields >> wrap);
+			m_wrapSprites = wrap != 0;
+		}
+		else if (type == "key")
+		{
+			InputLogEvent event;
+			unsigned int key = 0;
+			std::string action;
+			ok = (fields >> event.cycle >> event.instructionCount >> std::hex >> key >> action) && key <= 0xF
+				&& (action == "down" || action == "up") && (m_events.empty() || m_events.back().cycle <= event.cycle);
+			event.key = static_cast<uint8_t>(key);
+			event.pressed = action == "down";
+			if (ok) m_events.push_back(event);
+		}
+		else if (type == "end")
+		{
+			ok = static_cast<bool>(fields >> m_endCycle >> m_endInstructionCount >> std::hex >> m_endStateHash);
+			m_ended = ok;
+		}
+
+		if (!ok)
+		{
+			std::cerr << path << ":" << lineNumber << ": " << (sawHeader ? "malformed line" : "not a version 1 input log") << std::endl;
+			return false;
+		}
+	}
+
+	if (!m_ended)
+	{
+		std::cerr << path << ": no end line, the recording was cut short" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool InputLog::replay(Core& core, Keypad& keypad, const Rom& rom) const
+{
+	if (hashRom(rom) != m_romHash)
+	{
+		std::cerr << "The log was recorded with a different ROM" << std::endl;
+		return false;
+	}
+
+	keypad.setKeys(0);
+	core.loadProgram(rom);
+	core.seed(m_seed);
+	core.setSpriteWrapping(m_wrapSprites);
+
+	// same order the emulation thread hands events over in
+	for (size_t i = 0; i < m_events.size(); i++)
+	{
+		const InputLogEvent& event = m_events[i];
+		runUntil(core, event.cycle);
+		if (core.getInstructionCount() != event.instructionCount)
+		{
+			std::cerr << "Diverged before event " << i << " at cycle " << event.cycle << ": " << core.getInstructionCount()
+				<< " instructions run, recording had " << event.instructionCount << std::endl;
+			return false;
+		}
+
+		KeyEvent keyEvent = { event.key, event.pressed, 0 };
+		keypad.apply(keyEvent);
+		if (event.pressed) core.keyPressed(event.key);
+	}
+
+	runUntil(core, m_endCycle);
+	if (core.getInstructionCount() != m_endInstructionCount || core.stateHash() != m_endStateHash)
+	{
+		std::cerr << "Diverged by the end at cycle " << m_endCycle << ": state " << std::hex << core.stateHash() << ", recording had "
+			<< m_endStateHash << std::dec << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// FNV-1a, same as Core::stateHash
+uint64_t InputLog::hashRom(const Rom& rom)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	const uint8_t* data = rom.getData();
+	for (size_t i = 0; i < rom.getSize(); i++)
+	{
+		hash ^= data[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+size_t InputLog::getEventCount() const
+{
+	return m_events.size();
+}
+
+uint64_t InputLog::getEndCycle() const
+{
+	return m_endCycle;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Core.h"
+#include "Keypad.h"
+#include "Rom.h"
+
+struct InputLogEvent
+{
+	uint64_t cycle;			   // when the core took the event, always between two run() calls
+	uint64_t instructionCount; // where it should have got to by then, checked on replay to catch divergence early
+	uint8_t key;
+	bool pressed;
+};
+
+// Everything needed to run a session again and end up in the same state: the ROM it ran (by hash), the RNG seed,
+// the quirks, every key event against the emulated time the core saw it at, and the final state to compare with.
+// Saved as text:
+//     chip8-input-log 1
+//     rom 9d2c6a3e11f0b7a4
+//     seed 1234
+//     wrap 0
+//     key 4210 4210 5 down     # cycle, instructions, chip8 key
+//     end 36000 35120 0f3e...  # cycle, instructions, Core::stateHash
+class InputLog
+{
+public:
+	static const int VERSION = 1;
+
+	InputLog();
+
+	void begin(const Rom& rom, uint32_t seed, bool wrapSprites); // starts an empty log
+	void record(const Core& core, const KeyEvent& event); // after it's been handed to the core
+	void end(const Core& core);
+
+	bool save(const char* path) const;
+	bool load(const char* path); // malformed logs are reported and rejected
+
+	// resets the core and plays the log back into it as fast as it'll go
+	// returns false if the ROM is a different one or the run diverges from the recording, the first mismatch is reported
+	bool replay(Core& core, Keypad& keypad, const Rom& rom) const;
+
+	static uint64_t hashRom(const Rom& rom);
+
+	size_t getEventCount() const;
+	uint64_t getEndCycle() const;
+
+private:
+	uint64_t m_romHash;
+	uint32_t m_seed;
+	bool m_wrapSprites;
+	std::vector<InputLogEvent> m_events;
+
+	bool m_ended;
+	uint64_t m_endCycle;
+	uint64_t m_endInstructionCount;
+	uint64_t m_endStateHash;
+};
@@ -0,0 +1,424 @@
+#include <cstring>
+
+#include "Jit.h"
+
+#ifdef CHIP8_HAS_JIT
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#endif
+
+namespace
+{
+	enum HostRegister
+	{
+		RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+		R8, R9, R10, R11, R12, R13, R14, R15
+	};
+
+	// rax is scratch, rbp counts executed instructions, r12 holds the budget,
+	// r13 holds I, r14 points at I and r15 points at the V registers
+	const int TEMP = RAX;
+	const int EXECUTED = RBP;
+	const int BUDGET = R12;
+	const int INDEX = R13;
+	const int INDEX_POINTER = R14;
+	const int REGISTERS_POINTER = R15;
+
+	// host registers V registers get pinned to, a block ends early if it needs more than this
+	const int PINNABLE[] = { RCX, RDX, RSI, RDI, RBX, R8, R9, R10, R11 };
+	const int PINNABLE_COUNT = sizeof(PINNABLE) / sizeof(PINNABLE[0]);
+
+	// callee saved on either Win64 or SysV, pushed in this order
+	const int SAVED[] = { RBX, RBP, RSI, RDI, R12, R13, R14, R15 };
+	const int SAVED_COUNT = sizeof(SAVED) / sizeof(SAVED[0]);
+
+#ifdef _WIN32
+	const int ARGUMENTS[] = { RCX, RDX, R8 };
+#else
+	const int ARGUMENTS[] = { RDI, RSI, RDX };
+#endif
+}
+
+Jit::Jit()
+	: m_arena(nullptr), m_arenaUsed(0)
+{
+#ifdef CHIP8_HAS_JIT
+#ifdef _WIN32
+	m_arena = static_cast<uint8_t*>(VirtualAlloc(nullptr, ARENA_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+#else
+	void* arena = mmap(nullptr, ARENA_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	m_arena = (arena == MAP_FAILED) ? nullptr : static_cast<uint8_t*>(arena);
+#endif
+#endif
+	invalidateAll();
+}
+
+Jit::~Jit()
+{
+#ifdef CHIP8_HAS_JIT
+	if (!m_arena) return;
+#ifdef _WIN32
+	VirtualFree(m_arena, 0, MEM_RELEASE);
+#else
+	munmap(m_arena, ARENA_SIZE);
+#endif
+#endif
+}
+
+const Jit::Block* Jit::lookup(uint16_t address, const uint8_t* memory)
+{
+#ifdef CHIP8_HAS_JIT
+	if (!m_arena || (address & 0xF001)) return nullptr;
+
+	Block& block = blocks[address >> 1];
+	if (!block.tried) compile(address, memory, block);
+	return block.code ? &block : nullptr;
+#else
+	return nullptr;
+#endif
+}
+
+void Jit::invalidate(uint16_t address)
+{
+	if (address >= 4096) return;
+
+	// only blocks starting up to MAX_BLOCK_LENGTH instructions back can reach this byte
+	int first = address - (MAX_BLOCK_LENGTH * 2 - 1);
+	if (first < 0) first = 0;
+
+	for (int start = first & ~1; start <= address; start += 2)
+	{
+		Block& block = blocks[start >> 1];
+		int length = (block.length > 0) ? block.length : 1; // uncompilable entries still depend on their first instruction
+		if (block.tried && address < start + length * 2)
+		{
+			block.code = nullptr;
+			block.length = 0;
+			block.tried = false;
+		}
+	}
+}
+
+void Jit::invalidateAll()
+{
+	for (int i = 0; i < 4096 / 2; i++)
+	{
+		blocks[i].code = nullptr;
+		blocks[i].length = 0;
+		blocks[i].tried = false;
+	}
+	m_arenaUsed = 0;
+}
+
+bool Jit::isCompilable(uint16_t opcode)
+{
+	switch (opcode >> 12)
+	{
+	case 0x6:
+	case 0x7:
+	case 0xA:
+		return true;
+	case 0x8:
+		return (opcode & 0x000F) <= 0x7 || (opcode & 0x000F) == 0xE;
+	case 0xF:
+		return (opcode & 0x00FF) == 0x1E;
+	default:
+		return false;
+	}
+}
+
+void Jit::compile(uint16_t address, const uint8_t* memory, Block& block)
+{
+	block.tried = true;
+	block.code = nullptr;
+	block.length = 0;
+
+	// first pass: find where the block ends and which V registers it needs
+	int hostRegister[16];
+	for (int i = 0; i < 16; i++) hostRegister[i] = -1;
+	int pinned = 0;
+
+	uint16_t opcodes[MAX_BLOCK_LENGTH];
+	int length = 0;
+	for (uint16_t pc = address; length < MAX_BLOCK_LENGTH && pc < 4096 - 1; pc += 2)
+	{
+		uint16_t opcode = memory[pc] << 8 | memory[pc + 1];
+		if (!isCompilable(opcode)) break;
+
+		int needed[3] = { -1, -1, -1 };
+		switch (opcode >> 12)
+		{
+		case 0x6:
+		case 0x7:
+		case 0xF:
+			needed[0] = (opcode & 0x0F00) >> 8;
+			break;
+		case 0x8:
+			needed[0] = (opcode & 0x0F00) >> 8;
+			needed[1] = (opcode & 0x00F0) >> 4;
+			needed[2] = 0xF;
+			break;
+		}
+
+		int newRegisters = 0;
+		for (int i = 0; i < 3; i++)
+		{
+			if (needed[i] < 0 || hostRegister[needed[i]] >= 0) continue;
+			bool duplicate = false;
+			for (int j = 0; j < i; j++) duplicate = duplicate || needed[j] == needed[i];
+			if (!duplicate) newRegisters++;
+		}
+		if (pinned + newRegisters > PINNABLE_COUNT) break;
+
+		for (int i = 0; i < 3; i++)
+		{
+			if (needed[i] >= 0 && hostRegister[needed[i]] < 0) hostRegister[needed[i]] = PINNABLE[pinned++];
+		}
+		opcodes[length++] = opcode;
+	}
+
+	if (length == 0) return;
+
+	// second pass: emit
+	m_code.clear();
+
+	for (int i = 0; i < SAVED_COUNT; i++)
+	{
+		emitRex(false, 0, SAVED[i]);
+		emit(0x50 + (SAVED[i] & 7)); // push
+	}
+
+	// move the arguments out of the way before any of their registers get pinned
+	emitRex(true, ARGUMENTS[0], REGISTERS_POINTER);
+	emit(0x89);
+	emit(0xC0 | (ARGUMENTS[0] & 7) << 3 | (REGISTERS_POINTER & 7));
+	emitRex(true, ARGUMENTS[1], INDEX_POINTER);
+	emit(0x89);
+	emit(0xC0 | (ARGUMENTS[1] & 7) << 3 | (INDEX_POINTER & 7));
+	emitRegReg(0x89, BUDGET, ARGUMENTS[2]);
+
+	for (int v = 0; v < 16; v++)
+	{
+		if (hostRegister[v] < 0) continue;
+		emitRex(false, hostRegister[v], REGISTERS_POINTER);
+		emit(0x0F); // movzx host, byte [r15 + v]
+		emit(0xB6);
+		emit(0x40 | (hostRegister[v] & 7) << 3 | (REGISTERS_POINTER & 7));
+		emit(static_cast<uint8_t>(v));
+	}
+	emitRex(false, INDEX, INDEX_POINTER);
+	emit(0x0F); // movzx r13d, word [r14]
+	emit(0xB7);
+	emit((INDEX & 7) << 3 | (INDEX_POINTER & 7));
+	emitRegReg(0x31, EXECUTED, EXECUTED); // xor ebp, ebp
+
+	std::vector<size_t> exits; // rel32 fields to patch to the epilogue
+	for (int i = 0; i < length; i++)
+	{
+		uint16_t opcode = opcodes[i];
+		int x = hostRegister[(opcode & 0x0F00) >> 8];
+		int y = hostRegister[(opcode & 0x00F0) >> 4];
+		int f = hostRegister[0xF];
+		uint8_t kk = opcode & 0x00FF;
+
+		// the order of every sequence below matches the interpreter, including when x or y is F
+		switch (opcode >> 12)
+		{
+		case 0x6:
+			emitMovImm(x, kk);
+			break;
+		case 0x7:
+			emitAluImm(0, x, kk);
+			emitAluImm(4, x, 0xFF);
+			break;
+		case 0xA:
+			emitMovImm(INDEX, opcode & 0x0FFF);
+			break;
+		case 0xF: // Fx1E
+			emitRegReg(0x01, INDEX, x);
+			emitAluImm(4, INDEX, 0xFFFF);
+			break;
+		case 0x8:
+			switch (opcode & 0x000F)
+			{
+			case 0x0:
+				emitRegReg(0x89, x, y);
+				break;
+			case 0x1:
+				emitRegReg(0x09, x, y);
+				break;
+			case 0x2:
+				emitRegReg(0x21, x, y);
+				break;
+			case 0x3:
+				emitRegReg(0x31, x, y);
+				break;
+			case 0x4:
+				emitRegReg(0x89, TEMP, x);
+				emitRegReg(0x01, TEMP, y);
+				emitRegReg(0x89, f, TEMP);
+				emitShift(5, f, 8);
+				emitAluImm(4, TEMP, 0xFF);
+				emitRegReg(0x89, x, TEMP);
+				break;
+			case 0x5:
+				emitRegReg(0x39, x, y);
+				emitSetaZeroExtend();
+				emitRegReg(0x89, f, TEMP);
+				emitRegReg(0x29, x, y);
+				emitAluImm(4, x, 0xFF);
+				break;
+			case 0x6:
+				emitRegReg(0x89, TEMP, x);
+				emitAluImm(4, TEMP, 0x01);
+				emitRegReg(0x89, f, TEMP);
+				emitShift(5, x, 1);
+				break;
+			case 0x7:
+				emitRegReg(0x39, y, x);
+				emitSetaZeroExtend();
+				emitRegReg(0x89, f, TEMP);
+				emitRegReg(0x89, TEMP, y);
+				emitRegReg(0x29, TEMP, x);
+				emitAluImm(4, TEMP, 0xFF);
+				emitRegReg(0x89, x, TEMP);
+				break;
+			case 0xE:
+				emitRegReg(0x89, TEMP, x);
+				emitShift(5, TEMP, 7);
+				emitRegReg(0x89, f, TEMP);
+				emitShift(4, x, 1);
+				emitAluImm(4, x, 0xFF);
+				break;
+			}
+			break;
+		}
+
+		emit(0xFF); // inc ebp
+		emit(0xC0 | (EXECUTED & 7));
+		if (i + 1 < length)
+		{
+			emitRegReg(0x39, EXECUTED, BUDGET); // cmp ebp, r12d
+			emit(0x0F); // je epilogue
+			emit(0x84);
+			exits.push_back(m_code.size());
+			emit32(0);
+		}
+	}
+
+	// epilogue: write the pinned registers back
+	size_t epilogue = m_code.size();
+	for (size_t i = 0; i < exits.size(); i++)
+	{
+		uint32_t rel = static_cast<uint32_t>(epilogue - (exits[i] + 4));
+		memcpy(&m_code[exits[i]], &rel, 4);
+	}
+
+	for (int v = 0; v < 16; v++)
+	{
+		if (hostRegister[v] < 0) continue;
+		emitRex(false, hostRegister[v], REGISTERS_POINTER, true);
+		emit(0x88); // mov byte [r15 + v], host
+		emit(0x40 | (hostRegister[v] & 7) << 3 | (REGISTERS_POINTER & 7));
+		emit(static_cast<uint8_t>(v));
+	}
+	emit(0x66); // mov word [r14], r13w
+	emitRex(false, INDEX, INDEX_POINTER);
+	emit(0x89);
+	emit((INDEX & 7) << 3 | (INDEX_POINTER & 7));
+	emitRegReg(0x89, RAX, EXECUTED);
+
+	for (int i = SAVED_COUNT - 1; i >= 0; i--)
+	{
+		emitRex(false, 0, SAVED[i]);
+		emit(0x58 + (SAVED[i] & 7)); // pop
+	}
+	emit(0xC3); // ret
+
+#ifdef CHIP8_HAS_JIT
+	if (m_arenaUsed + m_code.size() > ARENA_SIZE)
+	{
+		invalidateAll(); // this resets block too, so mark it again
+		block.tried = true;
+	}
+
+	uint8_t* destination = m_arena + m_arenaUsed;
+#ifdef _WIN32
+	DWORD oldProtection;
+	VirtualProtect(m_arena, ARENA_SIZE, PAGE_READWRITE, &oldProtection);
+	memcpy(destination, m_code.data(), m_code.size());
+	VirtualProtect(m_arena, ARENA_SIZE, PAGE_EXECUTE_READ, &oldProtection);
+	FlushInstructionCache(GetCurrentProcess(), destination, m_code.size());
+#else
+	mprotect(m_arena, ARENA_SIZE, PROT_READ | PROT_WRITE);
+	memcpy(destination, m_code.data(), m_code.size());
+	mprotect(m_arena, ARENA_SIZE, PROT_READ | PROT_EXEC);
+#endif
+	m_arenaUsed += (m_code.size() + 15) & ~static_cast<size_t>(15);
+
+	block.code = reinterpret_cast<BlockFunction>(destination);
+	block.length = static_cast<uint16_t>(length);
+#endif
+}
+
+void Jit::emit(uint8_t byte)
+{
+	m_code.push_back(byte);
+}
+
+void Jit::emit32(uint32_t value)
+{
+	for (int i = 0; i < 4; i++)
+	{
+		emit(static_cast<uint8_t>(value >> (i * 8)));
+	}
+}
+
+void Jit::emitRex(bool w, int reg, int rm, bool force)
+{
+	uint8_t rex = 0x40 | (w ? 0x08 : 0x00) | ((reg & 8) ? 0x04 : 0x00) | ((rm & 8) ? 0x01 : 0x00);
+	if (rex != 0x40 || force) emit(rex);
+}
+
+void Jit::emitRegReg(uint8_t opcode, int dst, int src)
+{
+	emitRex(false, src, dst);
+	emit(opcode);
+	emit(0xC0 | (src & 7) << 3 | (dst & 7));
+}
+
+void Jit::emitMovImm(int dst, uint32_t imm)
+{
+	emitRex(false, 0, dst);
+	emit(0xB8 + (dst & 7));
+	emit32(imm);
+}
+
+void Jit::emitAluImm(int ext, int dst, uint32_t imm)
+{
+	emitRex(false, 0, dst);
+	emit(0x81);
+	emit(0xC0 | ext << 3 | (dst & 7));
+	emit32(imm);
+}
+
+void Jit::emitShift(int ext, int dst, uint8_t amount)
+{
+	emitRex(false, 0, dst);
+	emit(0xC1);
+	emit(0xC0 | ext << 3 | (dst & 7));
+	emit(amount);
+}
+
+void Jit::emitSetaZeroExtend()
+{
+	emit(0x0F); // seta al
+	emit(0x97);
+	emit(0xC0);
+	emit(0x0F); // movzx eax, al
+	emit(0xB6);
+	emit(0xC0);
+}
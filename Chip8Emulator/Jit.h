@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CHIP8_HAS_JIT
+#endif
+
+// Basic block recompiler to x86-64.
+// Straight-line runs of 6xkk, 7xkk, 8xy*, Annn and Fx1E are translated to native code with every V register the block
+// touches (and I) pinned in a host register. The block stops in front of the first instruction it can't translate
+// (branches, skips, memory, timers...) and the interpreter runs that one instead.
+// On other architectures lookup() always returns nullptr, so the interpreter runs everything.
+class Jit
+{
+public:
+	// runs at most budget (>= 1) instructions of the block, returns how many actually ran
+	typedef uint32_t (*BlockFunction)(uint8_t* registers, uint16_t* indexRegister, uint32_t budget);
+
+	struct Block
+	{
+		BlockFunction code; // nullptr if not compiled
+		uint16_t length;	// in instructions, 0 if the first instruction can't be compiled
+		bool tried;
+	};
+
+	Jit();
+	~Jit();
+
+	// returns the block starting at address (compiling it first if needed), or nullptr if there isn't one
+	const Block* lookup(uint16_t address, const uint8_t* memory);
+
+	void invalidate(uint16_t address); // drops every block containing the byte at address
+	void invalidateAll();
+
+private:
+	static const int MAX_BLOCK_LENGTH = 64;
+	static const size_t ARENA_SIZE = 256 * 1024;
+
+	Block blocks[4096 / 2];
+
+	uint8_t* m_arena;
+	size_t m_arenaUsed;
+	std::vector<uint8_t> m_code; // block being assembled
+
+	void compile(uint16_t address, const uint8_t* memory, Block& block);
+	static bool isCompilable(uint16_t opcode);
+
+	// x86-64 encoding helpers, registers use the hardware numbering (rax = 0 ... r15 = 15)
+	void emit(uint8_t byte);
+	void emit32(uint32_t value);
+	void emitRex(bool w, int reg, int rm, bool force = false);
+	void emitRegReg(uint8_t opcode, int dst, int src); // 32 bit "op dst, src" in the 01/09/21/29/31/39/89 family
+	void emitMovImm(int dst, uint32_t imm);
+	void emitAluImm(int ext, int dst, uint32_t imm); // 81 /ext id
+	void emitShift(int ext, int dst, uint8_t amount);  // C1 /ext ib
+	void emitSetaZeroExtend();						   // eax = above flag
+};
@@ -0,0 +1,78 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cctype>
+#include <cstdlib>
+
+#include "KeyMap.h"
+
+const char* KeyMap::DEFAULT_PATH = "keys.cfg";
+
+KeyMap::KeyMap()
+{
+	// GLFW uses the uppercase ASCII code for printable keys
+	const char* defaults = "X123QWEASDZC4RFV"; // indexed by chip8 key
+	for (int i = 0; i < 16; i++)
+	{
+		m_hostKeys[i] = defaults[i];
+	}
+}
+
+bool KeyMap::load(const char* path)
+{
+	std::ifstream file(path);
+	if (!file.is_open()) return false;
+
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(file, line))
+	{
+		lineNumber++;
+
+		size_t comment = line.find('#');
+		if (comment != std::string::npos) line.erase(comment);
+
+		std::istringstream fields(line);
+		std::string key, equals, hostKey;
+		if (!(fields >> key)) continue; // blank line
+
+		int hostKeyCode = -1;
+		if (fields >> equals >> hostKey && equals == "=") hostKeyCode = parseHostKey(hostKey.c_str());
+
+		char* end = nullptr;
+		long keyValue = std::strtol(key.c_str(), &end, 16);
+		if (*end != '\0' || keyValue < 0x0 || keyValue > 0xF || hostKeyCode < 0)
+		{
+			std::cerr << path << ":" << lineNumber << ": expected \"<chip8 key> = <host key>\"" << std::endl;
+			continue;
+		}
+
+		m_hostKeys[keyValue] = hostKeyCode;
+	}
+	return true;
+}
+
+int KeyMap::parseHostKey(const char* text)
+{
+	// a single character is that key (so "1" is the 1 key), anything longer is a key code
+	if (text[0] != '\0' && text[1] == '\0') return std::toupper(static_cast<unsigned char>(text[0]));
+
+	char* end = nullptr;
+	long code = std::strtol(text, &end, 10);
+	return (*end == '\0' && code > 0) ? static_cast<int>(code) : -1;
+}
+
+int KeyMap::getHostKey(uint8_t key) const
+{
+	return m_hostKeys[key & 0x0F];
+}
+
+int KeyMap::findKey(int hostKey) const
+{
+	for (int i = 0; i < 16; i++)
+	{
+		if (m_hostKeys[i] == hostKey) return i;
+	}
+	return -1;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+
+// Which host key (GLFW key code) drives each chip8 key.
+// Starts out as the usual layout (1234 / QWER / ASDF / ZXCV) and can be overridden from a config file with lines like
+//     # chip8 key = host key
+//     A = Z
+//     F = 86
+// where the host key is either a single printable character or a raw GLFW key code.
+class KeyMap
+{
+private:
+	int m_hostKeys[16];
+
+	static int parseHostKey(const char* text);
+
+public:
+	static const char* DEFAULT_PATH;
+
+	KeyMap();
+
+	// returns false if the file can't be opened. malformed lines are reported and skipped
+	bool load(const char* path);
+
+	int getHostKey(uint8_t key) const;
+	int findKey(int hostKey) const; // chip8 key driven by hostKey, -1 if it isn't mapped
+};
@@ -0,0 +1,27 @@
+#include "Keypad.h"
+
+Keypad::Keypad()
+	: m_keys(0), m_lastEventTime(0)
+{
+}
+
+void Keypad::apply(const KeyEvent& event)
+{
+	uint16_t bit = 1 << (event.key & 0x0F);
+	if (event.pressed)
+		m_keys.fetch_or(bit, std::memory_order_relaxed);
+	else
+		m_keys.fetch_and(static_cast<uint16_t>(~bit), std::memory_order_relaxed);
+
+	m_lastEventTime.store(event.timestamp, std::memory_order_relaxed);
+}
+
+void Keypad::setKeys(uint16_t keys)
+{
+	m_keys.store(keys, std::memory_order_relaxed);
+}
+
+int64_t Keypad::getLastEventTime() const
+{
+	return m_lastEventTime.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+
+struct KeyEvent
+{
+	uint8_t key; // chip8 key (0x0 - 0xF)
+	bool pressed;
+	int64_t timestamp; // FrameClock::now() when the host saw the event
+};
+
+// The 16 key chip8 keypad as one atomic word.
+// Whatever produces input (GLFW key callbacks, an evdev reader, a replay) writes it from its own thread,
+// and the Core reads it with a single load, so Ex9E/ExA1 are just a bit test.
+class Keypad
+{
+private:
+	std::atomic<uint16_t> m_keys; // bit n set = key n held
+	std::atomic<int64_t> m_lastEventTime;
+
+public:
+	Keypad();
+
+	void apply(const KeyEvent& event);
+	void setKeys(uint16_t keys); // replaces the whole state at once (scripts, replays)
+
+	uint16_t getKeys() const { return m_keys.load(std::memory_order_relaxed); }
+	bool isKeyPressed(uint8_t key) const { return (getKeys() >> key) & 0x01; }
+
+	// timestamp of the newest event, 0 if there hasn't been one. used to measure input to screen latency
+	int64_t getLastEventTime() const;
+};
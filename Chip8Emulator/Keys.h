@@ -1,40 +0,0 @@
-#pragma once
-
-#include <glad/glad.h>
-#include <GLFW/glfw3.h>
-
-#define KEY_1 GLFW_KEY_1
-#define KEY_2 GLFW_KEY_2
-#define KEY_3 GLFW_KEY_3
-#define KEY_C GLFW_KEY_4
-#define KEY_4 GLFW_KEY_Q
-#define KEY_5 GLFW_KEY_W
-#define KEY_6 GLFW_KEY_E
-#define KEY_D GLFW_KEY_R
-#define KEY_7 GLFW_KEY_A
-#define KEY_8 GLFW_KEY_S
-#define KEY_9 GLFW_KEY_D
-#define KEY_E GLFW_KEY_F
-#define KEY_A GLFW_KEY_Z
-#define KEY_0 GLFW_KEY_X
-#define KEY_B GLFW_KEY_C
-#define KEY_F GLFW_KEY_V
-
-const int KEY_MAP[16] = {
-	KEY_0,
-	KEY_1,
-	KEY_2,
-	KEY_3,
-	KEY_4,
-	KEY_5,
-	KEY_6,
-	KEY_7,
-	KEY_8,
-	KEY_9,
-	KEY_A,
-	KEY_B,
-	KEY_C,
-	KEY_D,
-	KEY_E,
-	KEY_F
-};
\ No newline at end of file
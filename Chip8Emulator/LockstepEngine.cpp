@@ -0,0 +1,504 @@
+#include <cstring>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "LockstepEngine.h"
+#include "Core.h"
+
+#ifdef __AVX2__
+namespace
+{
+	inline __m256i load(const uint8_t* p)
+	{
+		return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+	}
+
+	// only lanes with mask set take the new value
+	inline void storeMasked(uint8_t* p, __m256i value, __m256i mask)
+	{
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(p), _mm256_blendv_epi8(load(p), value, mask));
+	}
+
+	// unsigned a > b, as 0x01/0x00 per lane
+	inline __m256i greaterThan(__m256i a, __m256i b)
+	{
+		__m256i lessOrEqual = _mm256_cmpeq_epi8(_mm256_min_epu8(a, b), a);
+		return _mm256_andnot_si256(lessOrEqual, _mm256_set1_epi8(0x01));
+	}
+}
+#endif
+
+LockstepEngine::LockstepEngine(size_t laneCount)
+	: laneCount(laneCount), paddedCount((laneCount + VECTOR_WIDTH - 1) / VECTOR_WIDTH * VECTOR_WIDTH), groupCount(0),
+	generation(0), wrapSprites(false), cycleCount(0), instructionCount(0)
+{
+	registers.assign(16 * paddedCount, 0x00);
+	indexRegister.assign(paddedCount, 0x0000);
+	programCounter.assign(paddedCount, 0x0200);
+	stackPointer.assign(paddedCount, -1);
+	stack.assign(16 * paddedCount, 0x0000);
+	delayTimer.assign(paddedCount, 0x00);
+	soundTimer.assign(paddedCount, 0x00);
+	isWaitingForInput.assign(paddedCount, 0);
+	pendingRegister.assign(paddedCount, 0);
+	keys.assign(paddedCount, 0x0000);
+	generators.resize(paddedCount);
+
+	LaneMemory blank;
+	memset(&blank, 0x00, sizeof(blank));
+	memcpy(blank.memory, Core::fontset, sizeof(Core::fontset));
+	lanes.assign(laneCount, blank);
+
+	allLanesMask.assign(paddedCount, 0x00);
+	memset(allLanesMask.data(), 0xFF, laneCount);
+	groupMask.assign(paddedCount, 0x00);
+
+	size_t indexSize = 16;
+	while (indexSize < laneCount * 2) indexSize *= 2;
+	groupIndex.assign(indexSize, GroupSlot{ 0, 0 });
+}
+
+bool LockstepEngine::loadProgram(const uint8_t* program, size_t size)
+{
+	if (size > 4096 - 0x0200) return false;
+
+	for (size_t lane = 0; lane < laneCount; lane++)
+	{
+		memset(lanes[lane].memory + 0x0200, 0x00, 4096 - 0x0200);
+		memcpy(lanes[lane].memory + 0x0200, program, size);
+	}
+	return true;
+}
+
+void LockstepEngine::seed(size_t lane, uint32_t seed)
+{
+	generators[lane].seed(seed);
+}
+
+void LockstepEngine::setKeys(size_t lane, uint16_t keys)
+{
+	this->keys[lane] = keys;
+}
+
+void LockstepEngine::keyPressed(size_t lane, uint8_t key)
+{
+	if (!isWaitingForInput[lane]) return;
+
+	reg(pendingRegister[lane], static_cast<uint32_t>(lane)) = key & 0x0F;
+	isWaitingForInput[lane] = 0;
+}
+
+void LockstepEngine::run(uint32_t cycles)
+{
+	for (uint32_t i = 0; i < cycles; i++)
+	{
+		step();
+	}
+}
+
+void LockstepEngine::setSpriteWrapping(bool wrap)
+{
+	wrapSprites = wrap;
+}
+
+size_t LockstepEngine::getLaneCount() const
+{
+	return laneCount;
+}
+
+uint64_t LockstepEngine::getCycleCount() const
+{
+	return cycleCount;
+}
+
+uint64_t LockstepEngine::getInstructionCount() const
+{
+	return instructionCount;
+}
+
+const uint64_t* LockstepEngine::getFramebuffer(size_t lane) const
+{
+	return lanes[lane].framebuffer;
+}
+
+bool LockstepEngine::getIsWaitingForInput(size_t lane) const
+{
+	return isWaitingForInput[lane] != 0;
+}
+
+uint64_t LockstepEngine::stateHash(size_t lane) const
+{
+	uint8_t laneRegisters[16];
+	uint16_t laneStack[16];
+	for (size_t i = 0; i < 16; i++)
+	{
+		laneRegisters[i] = registers[i * paddedCount + lane];
+		laneStack[i] = stack[i * paddedCount + lane];
+	}
+
+	return Core::hashState(laneRegisters, indexRegister[lane], programCounter[lane], stackPointer[lane],
+		delayTimer[lane], soundTimer[lane], laneStack, lanes[lane].framebuffer, lanes[lane].memory);
+}
+
+void LockstepEngine::step()
+{
+	// regroup every cycle, lanes that took a different branch end up in their own group
+	groupCount = 0;
+	size_t hint = 0;
+	if (++generation == 0)
+	{
+		// wrapped, stale slots could now look current
+		for (size_t i = 0; i < groupIndex.size(); i++) groupIndex[i].generation = 0;
+		generation = 1;
+	}
+	for (uint32_t lane = 0; lane < laneCount; lane++)
+	{
+		if (isWaitingForInput[lane]) continue;
+
+		const uint8_t* memory = lanes[lane].memory;
+		uint16_t pc = programCounter[lane];
+		uint16_t opcode = memory[pc & 0x0FFF] << 8 | memory[(pc + 1) & 0x0FFF];
+
+		hint = findGroup(pc, opcode, hint);
+		groups[hint].lanes.push_back(lane);
+	}
+
+	for (size_t g = 0; g < groupCount; g++)
+	{
+		executeGroup(groups[g]);
+		instructionCount += groups[g].lanes.size();
+	}
+
+	cycleCount++;
+	if (cycleCount % Core::CYCLES_PER_TIMER_TICK == 0)
+	{
+		for (size_t lane = 0; lane < laneCount; lane++)
+		{
+			if (delayTimer[lane] > 0) delayTimer[lane]--;
+			if (soundTimer[lane] > 0) soundTimer[lane]--;
+		}
+	}
+}
+
+size_t LockstepEngine::findGroup(uint16_t programCounter, uint16_t opcode, size_t hint)
+{
+	// almost always the same group as the previous lane
+	if (hint < groupCount && groups[hint].programCounter == programCounter && groups[hint].opcode == opcode) return hint;
+
+	uint32_t key = static_cast<uint32_t>(programCounter) << 16 | opcode;
+	uint32_t hash = key * 2654435761u;
+	size_t mask = groupIndex.size() - 1;
+	size_t slot = (hash ^ (hash >> 16)) & mask;
+	for (; groupIndex[slot].generation == generation; slot = (slot + 1) & mask)
+	{
+		const Group& group = groups[groupIndex[slot].group];
+		if (group.programCounter == programCounter && group.opcode == opcode) return groupIndex[slot].group;
+	}
+	groupIndex[slot].generation = generation;
+	groupIndex[slot].group = static_cast<uint32_t>(groupCount);
+
+	if (groupCount == groups.size()) groups.emplace_back();
+	Group& group = groups[groupCount];
+	group.programCounter = programCounter;
+	group.opcode = opcode;
+	group.lanes.clear();
+	return groupCount++;
+}
+
+void LockstepEngine::executeGroup(const Group& group)
+{
+	// a full width pass only pays off if a decent fraction of the lanes are in the group
+	if (isAlu(group.opcode) && group.lanes.size() * 4 >= laneCount)
+	{
+		const uint8_t* mask = allLanesMask.data();
+		if (group.lanes.size() != laneCount)
+		{
+			memset(groupMask.data(), 0x00, paddedCount);
+			for (size_t i = 0; i < group.lanes.size(); i++)
+			{
+				groupMask[group.lanes[i]] = 0xFF;
+			}
+			mask = groupMask.data();
+		}
+		executeAluVector(group.opcode, mask);
+	}
+	else
+	{
+		for (size_t i = 0; i < group.lanes.size(); i++)
+		{
+			executeLane(group.lanes[i], group.opcode);
+		}
+	}
+
+	for (size_t i = 0; i < group.lanes.size(); i++)
+	{
+		programCounter[group.lanes[i]] += 2;
+	}
+}
+
+bool LockstepEngine::isAlu(uint16_t opcode)
+{
+	switch (opcode >> 12)
+	{
+	case 0x6:
+	case 0x7:
+		return true;
+	case 0x8:
+		return (opcode & 0x000F) <= 0x7 || (opcode & 0x000F) == 0xE;
+	default:
+		return false;
+	}
+}
+
+void LockstepEngine::executeAluVector(uint16_t opcode, const uint8_t* mask)
+{
+#ifdef __AVX2__
+	uint8_t* vx = &registers[((opcode & 0x0F00) >> 8) * paddedCount];
+	uint8_t* vy = &registers[((opcode & 0x00F0) >> 4) * paddedCount];
+	uint8_t* vf = &registers[0xF * paddedCount];
+	__m256i kk = _mm256_set1_epi8(static_cast<char>(opcode & 0x00FF));
+
+	// when x or y is F the flag is written first and re-read, same as Core
+	for (size_t i = 0; i < paddedCount; i += VECTOR_WIDTH)
+	{
+		__m256i m = load(mask + i);
+		__m256i a = load(vx + i);
+		__m256i b = load(vy + i);
+
+		switch (opcode >> 12)
+		{
+		case 0x6:
+			storeMasked(vx + i, kk, m);
+			break;
+		case 0x7:
+			storeMasked(vx + i, _mm256_add_epi8(a, kk), m);
+			break;
+		case 0x8:
+			switch (opcode & 0x000F)
+			{
+			case 0x0:
+				storeMasked(vx + i, b, m);
+				break;
+			case 0x1:
+				storeMasked(vx + i, _mm256_or_si256(a, b), m);
+				break;
+			case 0x2:
+				storeMasked(vx + i, _mm256_and_si256(a, b), m);
+				break;
+			case 0x3:
+				storeMasked(vx + i, _mm256_xor_si256(a, b), m);
+				break;
+			case 0x4:
+			{
+				__m256i sum = _mm256_add_epi8(a, b);
+				__m256i noCarry = _mm256_cmpeq_epi8(_mm256_adds_epu8(a, b), sum);
+				storeMasked(vf + i, _mm256_andnot_si256(noCarry, _mm256_set1_epi8(0x01)), m);
+				storeMasked(vx + i, sum, m);
+				break;
+			}
+			case 0x5:
+				storeMasked(vf + i, greaterThan(a, b), m);
+				storeMasked(vx + i, _mm256_sub_epi8(load(vx + i), load(vy + i)), m);
+				break;
+			case 0x6:
+				storeMasked(vf + i, _mm256_and_si256(a, _mm256_set1_epi8(0x01)), m);
+				a = load(vx + i);
+				storeMasked(vx + i, _mm256_and_si256(_mm256_srli_epi16(a, 1), _mm256_set1_epi8(0x7F)), m);
+				break;
+			case 0x7:
+				storeMasked(vf + i, greaterThan(b, a), m);
+				storeMasked(vx + i, _mm256_sub_epi8(load(vy + i), load(vx + i)), m);
+				break;
+			case 0xE:
+				storeMasked(vf + i, _mm256_and_si256(_mm256_srli_epi16(a, 7), _mm256_set1_epi8(0x01)), m);
+				a = load(vx + i);
+				storeMasked(vx + i, _mm256_add_epi8(a, a), m);
+				break;
+			}
+			break;
+		}
+	}
+#else
+	for (uint32_t lane = 0; lane < laneCount; lane++)
+	{
+		if (mask[lane]) executeAluLane(lane, opcode);
+	}
+#endif
+}
+
+void LockstepEngine::executeAluLane(uint32_t lane, uint16_t opcode)
+{
+	uint8_t x = (opcode & 0x0F00) >> 8;
+	uint8_t y = (opcode & 0x00F0) >> 4;
+	uint8_t kk = opcode & 0x00FF;
+
+	switch (opcode >> 12)
+	{
+	case 0x6:
+		reg(x, lane) = kk;
+		break;
+	case 0x7:
+		reg(x, lane) += kk;
+		break;
+	case 0x8:
+		switch (opcode & 0x000F)
+		{
+		case 0x0:
+			reg(x, lane) = reg(y, lane);
+			break;
+		case 0x1:
+			reg(x, lane) = reg(x, lane) | reg(y, lane);
+			break;
+		case 0x2:
+			reg(x, lane) = reg(x, lane) & reg(y, lane);
+			break;
+		case 0x3:
+			reg(x, lane) = reg(x, lane) ^ reg(y, lane);
+			break;
+		case 0x4:
+		{
+			uint16_t result = reg(x, lane) + reg(y, lane);
+			reg(0xF, lane) = (result > 0x00FF) ? 0x01 : 0x00;
+			reg(x, lane) = static_cast<uint8_t>(result);
+			break;
+		}
+		case 0x5:
+			reg(0xF, lane) = (reg(x, lane) > reg(y, lane)) ? 0x01 : 0x00;
+			reg(x, lane) = reg(x, lane) - reg(y, lane);
+			break;
+		case 0x6:
+			reg(0xF, lane) = reg(x, lane) & 0x01;
+			reg(x, lane) = reg(x, lane) >> 1;
+			break;
+		case 0x7:
+			reg(0xF, lane) = (reg(y, lane) > reg(x, lane)) ? 0x01 : 0x00;
+			reg(x, lane) = reg(y, lane) - reg(x, lane);
+			break;
+		case 0xE:
+			reg(0xF, lane) = (reg(x, lane) & 0x80) ? 0x01 : 0x00;
+			reg(x, lane) = reg(x, lane) << 1;
+			break;
+		}
+		break;
+	}
+}
+
+void LockstepEngine::executeLane(uint32_t lane, uint16_t opcode)
+{
+	uint8_t x = (opcode & 0x0F00) >> 8;
+	uint8_t y = (opcode & 0x00F0) >> 4;
+	uint8_t kk = opcode & 0x00FF;
+	uint16_t nnn = opcode & 0x0FFF;
+
+	uint16_t& pc = programCounter[lane];
+	uint16_t& index = indexRegister[lane];
+	int8_t& sp = stackPointer[lane];
+	uint8_t* memory = lanes[lane].memory;
+
+	// invalid opcodes are silently ignored here, printing them once per lane would drown everything else out
+	switch (opcode >> 12)
+	{
+	case 0x0:
+		if (kk == 0xE0)
+		{
+			memset(lanes[lane].framebuffer, 0x00, sizeof(lanes[lane].framebuffer));
+		}
+		else if (kk == 0xEE)
+		{
+			pc = stack[(sp & 0x0F) * paddedCount + lane];
+			sp--;
+		}
+		break;
+	case 0x1:
+		pc = nnn - 2;
+		break;
+	case 0x2:
+		sp++;
+		stack[(sp & 0x0F) * paddedCount + lane] = pc;
+		pc = nnn - 2;
+		break;
+	case 0x3:
+		if (reg(x, lane) == kk) pc += 2;
+		break;
+	case 0x4:
+		if (reg(x, lane) != kk) pc += 2;
+		break;
+	case 0x5:
+		if (reg(x, lane) == reg(y, lane)) pc += 2;
+		break;
+	case 0x6:
+	case 0x7:
+	case 0x8:
+		executeAluLane(lane, opcode);
+		break;
+	case 0x9:
+		if (reg(x, lane) != reg(y, lane)) pc += 2;
+		break;
+	case 0xA:
+		index = nnn;
+		break;
+	case 0xB:
+		pc = nnn + reg(0x0, lane) - 2;
+		break;
+	case 0xC:
+		reg(x, lane) = static_cast<uint8_t>(generators[lane]() >> 23) & kk;
+		break;
+	case 0xD:
+	{
+		uint8_t wrapped[15];
+		const uint8_t* sprite = Core::spriteAt(memory, index, opcode & 0x000F, wrapped);
+		bool collision = Core::updateFramebuffer(lanes[lane].framebuffer, sprite, reg(x, lane), reg(y, lane), opcode & 0x000F, wrapSprites);
+		reg(0xF, lane) = collision ? 0x01 : 0x00;
+		break;
+	}
+	case 0xE:
+	{
+		bool pressed = (keys[lane] >> (reg(x, lane) & 0x0F)) & 0x01;
+		if ((kk == 0x9E && pressed) || (kk == 0xA1 && !pressed)) pc += 2;
+		break;
+	}
+	case 0xF:
+		switch (kk)
+		{
+		case 0x07:
+			reg(x, lane) = delayTimer[lane];
+			break;
+		case 0x0A:
+			isWaitingForInput[lane] = 1;
+			pendingRegister[lane] = x;
+			break;
+		case 0x15:
+			delayTimer[lane] = reg(x, lane);
+			break;
+		case 0x18:
+			soundTimer[lane] = reg(x, lane);
+			break;
+		case 0x1E:
+			index += reg(x, lane);
+			break;
+		case 0x29:
+			index = reg(x, lane) * 5;
+			break;
+		case 0x33:
+			memory[index & 0x0FFF] = reg(x, lane) / 100;
+			memory[(index + 1) & 0x0FFF] = (reg(x, lane) / 10) % 10;
+			memory[(index + 2) & 0x0FFF] = reg(x, lane) % 10;
+			break;
+		case 0x55:
+			for (uint8_t i = 0; i <= x; i++)
+			{
+				memory[(index + i) & 0x0FFF] = reg(i, lane);
+			}
+			break;
+		case 0x65:
+			for (uint8_t i = 0; i <= x; i++)
+			{
+				reg(i, lane) = memory[(index + i) & 0x0FFF];
+			}
+			break;
+		}
+		break;
+	}
+}
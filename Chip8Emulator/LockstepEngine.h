@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <random>
+
+// Runs many copies of the same ROM (with different seeds/inputs) in lockstep.
+// Machine state is kept structure-of-arrays style, so when every lane is at the same instruction the ALU ops
+// (6xkk, 7xkk, 8xy*) are done for 32 lanes at a time with AVX2. Every cycle the lanes are grouped by
+// program counter + opcode, so lanes that diverge just end up in another group with the rest masked off,
+// and rejoin the main group if they reconverge. Groups are looked up through a small hash index, so regrouping stays
+// linear in the lane count however far the lanes spread. Everything that isn't an ALU op runs one lane at a time.
+// Each lane behaves exactly like a Core with the same seed and input, down to addresses wrapping at 4K and the stack
+// index at 16.
+class LockstepEngine
+{
+public:
+	LockstepEngine(size_t laneCount);
+
+	bool loadProgram(const uint8_t* program, size_t size); // into every lane, returns false if it doesn't fit
+	void seed(size_t lane, uint32_t seed);
+	void setKeys(size_t lane, uint16_t keys); // bit n set = key n held
+	void keyPressed(size_t lane, uint8_t key); // releases the lane if it's blocked on Fx0A
+
+	void run(uint32_t cycles);
+	void setSpriteWrapping(bool wrap); // same quirk as Core::setSpriteWrapping, for every lane
+
+	size_t getLaneCount() const;
+	uint64_t getCycleCount() const;
+	uint64_t getInstructionCount() const; // summed over every lane
+	const uint64_t* getFramebuffer(size_t lane) const;
+	bool getIsWaitingForInput(size_t lane) const;
+	uint64_t stateHash(size_t lane) const; // same as Core::stateHash for the same machine
+
+private:
+	static const size_t VECTOR_WIDTH = 32; // 8 bit lanes in an AVX2 register
+
+	struct LaneMemory
+	{
+		uint64_t framebuffer[32];
+		uint8_t memory[4096];
+	};
+
+	struct Group
+	{
+		uint16_t programCounter;
+		uint16_t opcode;
+		std::vector<uint32_t> lanes;
+	};
+
+	size_t laneCount;
+	size_t paddedCount; // laneCount rounded up to VECTOR_WIDTH, the padding lanes are never active
+
+	// registers[r * paddedCount + lane], stack[level * paddedCount + lane]
+	std::vector<uint8_t> registers;
+	std::vector<uint16_t> indexRegister;
+	std::vector<uint16_t> programCounter;
+	std::vector<int8_t> stackPointer;
+	std::vector<uint16_t> stack;
+	std::vector<uint8_t> delayTimer;
+	std::vector<uint8_t> soundTimer;
+	std::vector<uint8_t> isWaitingForInput;
+	std::vector<uint8_t> pendingRegister;
+	std::vector<uint16_t> keys;
+	std::vector<std::minstd_rand> generators;
+	std::vector<LaneMemory> lanes;
+
+	std::vector<uint8_t> allLanesMask; // 0xFF for every real lane
+	std::vector<uint8_t> groupMask;	   // 0xFF for the lanes in the group being executed
+	std::vector<Group> groups;
+	size_t groupCount;
+
+	// open addressing on pc << 16 | opcode, a slot only counts if it was written this cycle, so nothing is cleared
+	struct GroupSlot
+	{
+		uint32_t generation;
+		uint32_t group;
+	};
+	std::vector<GroupSlot> groupIndex; // power of two, at least twice the lane count so probes stay short
+	uint32_t generation;
+	bool wrapSprites;
+
+	uint64_t cycleCount;
+	uint64_t instructionCount;
+
+	void step();
+	size_t findGroup(uint16_t programCounter, uint16_t opcode, size_t hint);
+	void executeGroup(const Group& group);
+	void executeAluVector(uint16_t opcode, const uint8_t* mask);
+	void executeAluLane(uint32_t lane, uint16_t opcode);
+	void executeLane(uint32_t lane, uint16_t opcode);
+	static bool isAlu(uint16_t opcode);
+
+	uint8_t& reg(uint8_t r, uint32_t lane) { return registers[r * paddedCount + lane]; }
+};
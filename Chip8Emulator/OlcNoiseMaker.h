@@ -86,11 +86,13 @@ public:
 		m_nBlockCount = nBlocks;
 		m_nBlockSamples = nBlockSamples;
 		m_nBlockFree = m_nBlockCount;
+		m_nBlockLimit = m_nBlockCount; // modified
 		m_nBlockCurrent = 0;
 		m_pBlockMemory = nullptr;
 		m_pWaveHeaders = nullptr;
 
 		m_userFunction = nullptr;
+		m_blockFunction = nullptr;
 
 		// Validate device
 		vector<wstring> devices = Enumerate();
@@ -184,6 +186,29 @@ public:
 		m_userFunction = func;
 	}
 
+	// modified: caps how many blocks are queued on the device at once, so the latency can be less than the allocated buffer
+	void SetBlockLimit(unsigned int nBlocks)
+	{
+		if (nBlocks < 1) nBlocks = 1;
+		if (nBlocks > m_nBlockCount) nBlocks = m_nBlockCount;
+		m_nBlockLimit = nBlocks;
+		unique_lock<mutex> lm(m_muxBlockNotZero);
+		m_cvBlockNotZero.notify_one();
+	}
+
+	// modified: blocks handed to the device that it hasn't finished playing yet
+	unsigned int GetBlocksQueued()
+	{
+		return m_nBlockCount - m_nBlockFree;
+	}
+
+	// modified: fills a whole block (interleaved, m_nBlockSamples values) per call instead of one sample at a time
+	// takes priority over the user function when set
+	void SetBlockFunction(std::function<void(T*, unsigned int)> func)
+	{
+		m_blockFunction = func;
+	}
+
 	FTYPE clip(FTYPE dSample, FTYPE dMax)
 	{
 		if (dSample >= 0.0)
@@ -196,6 +221,7 @@ public:
 private:
 	//FTYPE(*m_userFunction)(int, FTYPE);
 	std::function<FTYPE(int, FTYPE)> m_userFunction;
+	std::function<void(T*, unsigned int)> m_blockFunction; // modified
 
 	unsigned int m_nSampleRate;
 	unsigned int m_nChannels;
@@ -210,6 +236,7 @@ private:
 	thread m_thread;
 	atomic<bool> m_bReady;
 	atomic<unsigned int> m_nBlockFree;
+	atomic<unsigned int> m_nBlockLimit; // modified
 	condition_variable m_cvBlockNotZero;
 	mutex m_muxBlockNotZero;
 
@@ -248,10 +275,11 @@ private:
 		while (m_bReady)
 		{
 			// Wait for block to become available
-			if (m_nBlockFree == 0)
+			// modified: also waits while the limit's worth of blocks are queued
+			if (m_nBlockFree == 0 || m_nBlockCount - m_nBlockFree >= m_nBlockLimit)
 			{
 				unique_lock<mutex> lm(m_muxBlockNotZero);
-				while (m_nBlockFree == 0) // sometimes, Windows signals incorrectly
+				while (m_nBlockFree == 0 || m_nBlockCount - m_nBlockFree >= m_nBlockLimit) // sometimes, Windows signals incorrectly
 					m_cvBlockNotZero.wait(lm);
 			}
 
@@ -265,6 +293,12 @@ private:
 			T nNewSample = 0;
 			int nCurrentBlock = m_nBlockCurrent * m_nBlockSamples;
 
+			if (m_blockFunction != nullptr) // modified
+			{
+				m_blockFunction(&m_pBlockMemory[nCurrentBlock], m_nBlockSamples);
+				m_dGlobalTime = m_dGlobalTime + dTimeStep * (m_nBlockSamples / m_nChannels);
+			}
+			else
 			for (unsigned int n = 0; n < m_nBlockSamples; n += m_nChannels)
 			{
 				// User Process
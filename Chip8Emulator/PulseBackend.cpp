@@ -0,0 +1,71 @@
+#ifdef CHIP8_HAS_PULSE
+
+#include <pulse/simple.h>
+#include <pulse/error.h>
+
+#include "PulseBackend.h"
+
+PulseBackend::PulseBackend()
+	: m_stream(nullptr), m_source(nullptr), m_running(false)
+{
+}
+
+PulseBackend::~PulseBackend()
+{
+	close();
+}
+
+bool PulseBackend::open(SampleSource* source)
+{
+	pa_sample_spec spec;
+	spec.format = PA_SAMPLE_S16NE;
+	spec.rate = SAMPLE_RATE;
+	spec.channels = 1;
+
+	// keep the server side buffer short, the defaults are around two seconds
+	// and start playing as soon as there's a block, rather than once the whole target is filled
+	pa_buffer_attr attributes;
+	attributes.maxlength = static_cast<uint32_t>(-1);
+	attributes.tlength = static_cast<uint32_t>(m_latency.getTargetSamples() * sizeof(int16_t));
+	attributes.prebuf = static_cast<uint32_t>(AdaptiveLatency::BLOCK_SAMPLES * sizeof(int16_t));
+	attributes.minreq = static_cast<uint32_t>(-1);
+	attributes.fragsize = static_cast<uint32_t>(-1);
+
+	int error = 0;
+	m_stream = pa_simple_new(nullptr, "Chip8", PA_STREAM_PLAYBACK, nullptr, "beeper", &spec, nullptr, &attributes, &error);
+	if (!m_stream) return false;
+
+	m_source = source;
+	m_running = true;
+	m_thread = std::thread(&PulseBackend::run, this);
+	return true;
+}
+
+void PulseBackend::close()
+{
+	if (!m_stream) return;
+
+	m_running = false;
+	m_thread.join();
+	pa_simple_free(m_stream);
+	m_stream = nullptr;
+}
+
+void PulseBackend::run()
+{
+	int16_t block[AdaptiveLatency::BLOCK_SAMPLES];
+	while (m_running)
+	{
+		int error = 0;
+		pa_usec_t latency = pa_simple_get_latency(m_stream, &error);
+		if (latency != static_cast<pa_usec_t>(-1)) m_latency.observe(static_cast<uint32_t>(latency * SAMPLE_RATE / 1000000));
+
+		m_source->render(block, AdaptiveLatency::BLOCK_SAMPLES);
+
+		// blocks until the server has room, which is what paces this thread
+		if (pa_simple_write(m_stream, block, sizeof(block), &error) < 0) break;
+		m_latency.written(AdaptiveLatency::BLOCK_SAMPLES);
+	}
+}
+
+#endif
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "AudioBackend.h"
+
+#ifdef CHIP8_HAS_PULSE
+
+#include <atomic>
+#include <thread>
+
+struct pa_simple;
+
+// PulseAudio (or PipeWire's pulse server) through the blocking simple API, written from its own thread
+// the simple API doesn't report underruns or let the buffer be resized, so this asks for the smallest target up front and
+// leaves the rest to the server, which raises a stream's latency by itself when it underruns. the stats still show the
+// queue depth, and count an underrun whenever it's found empty
+class PulseBackend : public AudioBackend
+{
+private:
+	pa_simple* m_stream;
+	SampleSource* m_source;
+	std::thread m_thread;
+	std::atomic<bool> m_running;
+
+	void run();
+
+public:
+	PulseBackend();
+	~PulseBackend();
+
+	bool open(SampleSource* source) override;
+	void close() override;
+	const char* getName() const override { return "pulse"; }
+};
+
+#endif
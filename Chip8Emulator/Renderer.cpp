@@ -1,7 +1,14 @@
 #include "Renderer.h"
 #include <iostream>
 
-Renderer::Renderer()
+const glm::mat4 PROJECTION_MATRIX = glm::ortho(
+	0.0f,  64.0f, // left to right
+	32.0f, 0.0f, // bottom to top
+	-1.0f, 1.0f  // near to far
+);
+
+Renderer::Renderer(RenderMode mode)
+	: m_mode(mode)
 {
 	//m_drawMap = new unsigned char[32 * 64];
 	//m_drawMap = new uint8_t[32 * 8]; // 32 rows of 64 bits (8 * 8 bits)
@@ -23,6 +30,9 @@ Renderer::Renderer()
 	//m_drawMap[32] = 0xF0;
 
 	m_shader = new Shader("shader.vert", "shader.frag");
+	m_shader->use();
+	m_shader->setMat4("projection", PROJECTION_MATRIX);
+	m_shader->setFloat("color", 1.0f, 1.0f, 1.0f);
 
 	float vertices[] = {
 		1.0f,  0.0f,  // top right
@@ -50,6 +60,15 @@ Renderer::Renderer()
 
 	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), 0);
 	glEnableVertexAttribArray(0);
+
+	// integer textures have to use nearest filtering, anything else makes them incomplete
+	glGenTextures(1, &m_texture);
+	glBindTexture(GL_TEXTURE_2D, m_texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, 2, 32, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
 }
 
 Renderer::~Renderer()
@@ -58,25 +77,52 @@ Renderer::~Renderer()
 	delete m_shader;
 	glDeleteBuffers(1, &m_VBO);
 	glDeleteBuffers(1, &m_EBO);
-	glDeleteBuffers(1, &m_VAO);
+	glDeleteVertexArrays(1, &m_VAO);
+	glDeleteTextures(1, &m_texture);
+}
+
+void Renderer::draw(const uint64_t* framebuffer, int height, int width)
+{
+	if (m_mode == RenderMode::Texture)
+		drawTexture(framebuffer, height, width);
+	else
+		drawPerPixel(framebuffer, height, width);
 }
 
-void Renderer::draw(uint8_t* framebuffer, int height, int width)
+// the whole framebuffer is one quad, shader.frag picks the bit for each fragment out of the texture
+void Renderer::drawTexture(const uint64_t* framebuffer, int height, int width)
+{
+	// split each row into its left and right halves so the upload doesn't depend on host byte order
+	uint32_t halves[32 * 2];
+	for (int row = 0; row < height; row++)
+	{
+		halves[row * 2] = static_cast<uint32_t>(framebuffer[row] >> 32);
+		halves[row * 2 + 1] = static_cast<uint32_t>(framebuffer[row]);
+	}
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, m_texture);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 2, height, GL_RED_INTEGER, GL_UNSIGNED_INT, halves);
+
+	m_shader->use();
+	m_shader->setBool("unpack", true);
+	m_shader->setInt("framebuffer", 0);
+	m_shader->setMat4("model", glm::scale(glm::mat4(1.0f), glm::vec3(width, height, 1.0f)));
+	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+}
+
+void Renderer::drawPerPixel(const uint64_t* framebuffer, int height, int width)
 {
 	glm::mat4 model(1.0f);
+	m_shader->use();
+	m_shader->setBool("unpack", false);
 
 	for (int i = 0; i < height * width; i++)
 	{
 		int row = i / width;
 		int col = i % width;
-		int numBytes = width / 8;
-
-		int colByte = col / numBytes;
-		int colOffset = (numBytes - 1) - (col % numBytes);
-
-		uint8_t currByte = framebuffer[(row * 8) + colByte];
 
-		if ((currByte >> colOffset) & 0x01)
+		if ((framebuffer[row] >> (63 - col)) & 0x01)
 		{
 			model = glm::translate(model, glm::vec3(col, row, 0.0f));
 			m_shader->setMat4("model", model);
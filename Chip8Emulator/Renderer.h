@@ -4,6 +4,12 @@
 
 #include "Shader.h"
 
+enum class RenderMode
+{
+	PerPixel, // one quad and one draw call per lit pixel
+	Texture	  // framebuffer uploaded as a texture, unpacked in shader.frag, one draw call
+};
+
 class Renderer
 {
 private:
@@ -11,11 +17,15 @@ private:
 	unsigned int m_VBO;
 	unsigned int m_EBO;
 	unsigned int m_VAO;
+	unsigned int m_texture; // 2 x 32 single channel integer texture, one texel per half row
+	RenderMode m_mode;
+
+	void drawPerPixel(const uint64_t* framebuffer, int height, int width);
+	void drawTexture(const uint64_t* framebuffer, int height, int width);
 
 public:
-	Renderer();
+	Renderer(RenderMode mode = RenderMode::Texture);
 	~Renderer();
 	
-	void draw(uint8_t* framebuffer, int height, int width);
+	void draw(const uint64_t* framebuffer, int height, int width);
 };
-
@@ -0,0 +1,172 @@
+#include <cstring>
+
+#include "RewindBuffer.h"
+
+namespace
+{
+	// zero runs shorter than this stay inside the literal, a new run header would cost more than the bytes it skips
+	const size_t MIN_ZERO_RUN = 3;
+
+	uint8_t* writeLength(uint8_t* out, size_t value)
+	{
+		while (value >= 0x80)
+		{
+			*out++ = static_cast<uint8_t>(value | 0x80);
+			value >>= 7;
+		}
+		*out++ = static_cast<uint8_t>(value);
+		return out;
+	}
+
+	const uint8_t* readLength(const uint8_t* in, size_t& value)
+	{
+		value = 0;
+		int shift = 0;
+		uint8_t byte;
+		do
+		{
+			byte = *in++;
+			value |= static_cast<size_t>(byte & 0x7F) << shift;
+			shift += 7;
+		} while (byte & 0x80);
+		return in;
+	}
+}
+
+RewindBuffer::RewindBuffer(size_t budget, size_t maxFrames)
+	: m_hasNewest(false), m_arena(budget < MAX_DELTA_SIZE * 4 ? MAX_DELTA_SIZE * 4 : budget), m_writePos(0), m_bytesUsed(0),
+	m_records(maxFrames > 0 ? maxFrames : 1), m_first(0), m_count(0)
+{
+}
+
+void RewindBuffer::push(const Snapshot& snapshot)
+{
+	if (m_hasNewest)
+	{
+		size_t size = encode(reinterpret_cast<const uint8_t*>(&m_newest), reinterpret_cast<const uint8_t*>(&snapshot), sizeof(Snapshot), m_scratch);
+		memcpy(reserve(size), m_scratch, size);
+	}
+
+	m_newest = snapshot;
+	m_hasNewest = true;
+}
+
+bool RewindBuffer::stepBack(Snapshot& snapshot)
+{
+	if (m_count == 0) return false;
+
+	m_count--;
+	const Record& record = m_records[(m_first + m_count) % m_records.size()];
+	apply(&m_arena[record.offset], record.size, reinterpret_cast<uint8_t*>(&m_newest));
+	m_writePos = record.offset; // the newest record always sits right below the write position
+	m_bytesUsed -= record.size;
+
+	snapshot = m_newest;
+	return true;
+}
+
+void RewindBuffer::clear()
+{
+	m_hasNewest = false;
+	m_writePos = 0;
+	m_bytesUsed = 0;
+	m_first = 0;
+	m_count = 0;
+}
+
+size_t RewindBuffer::getFrameCount() const
+{
+	return m_count;
+}
+
+size_t RewindBuffer::getBytesUsed() const
+{
+	return m_bytesUsed + (m_hasNewest ? sizeof(Snapshot) : 0);
+}
+
+// [zero run length][literal length][literal bytes] repeated, lengths as 7 bit varints. trailing zeros aren't written at all
+size_t RewindBuffer::encode(const uint8_t* from, const uint8_t* to, size_t size, uint8_t* out)
+{
+	uint8_t* start = out;
+	size_t position = 0;
+	size_t runStart = 0; // first byte not covered by a run yet
+
+	while (position < size)
+	{
+		// skip unchanged bytes a word at a time, that's nearly all of them
+		while (position + 8 <= size)
+		{
+			uint64_t a, b;
+			memcpy(&a, from + position, 8);
+			memcpy(&b, to + position, 8);
+			if (a != b) break;
+			position += 8;
+		}
+		while (position < size && from[position] == to[position]) position++;
+		if (position == size) break;
+
+		size_t literalStart = position;
+		size_t zeros = 0;
+		while (position < size && zeros < MIN_ZERO_RUN)
+		{
+			zeros = (from[position] == to[position]) ? zeros + 1 : 0;
+			position++;
+		}
+		size_t literalEnd = position - zeros;
+
+		out = writeLength(out, literalStart - runStart);
+		out = writeLength(out, literalEnd - literalStart);
+		for (size_t i = literalStart; i < literalEnd; i++)
+		{
+			*out++ = from[i] ^ to[i];
+		}
+		runStart = literalEnd;
+	}
+
+	return out - start;
+}
+
+void RewindBuffer::apply(const uint8_t* delta, size_t deltaSize, uint8_t* state)
+{
+	const uint8_t* end = delta + deltaSize;
+	while (delta < end)
+	{
+		size_t skip, length;
+		delta = readLength(delta, skip);
+		delta = readLength(delta, length);
+		state += skip;
+		for (size_t i = 0; i < length; i++)
+		{
+			*state++ ^= *delta++;
+		}
+	}
+}
+
+uint8_t* RewindBuffer::reserve(size_t size)
+{
+	if (m_count == m_records.size()) dropOldest();
+
+	size_t start = m_writePos;
+	if (start + size > m_arena.size())
+	{
+		// doesn't fit before the end, the records still out there are the oldest ones so they go first
+		while (m_count > 0 && m_records[m_first].offset >= start) dropOldest();
+		start = 0;
+	}
+	while (m_count > 0 && m_records[m_first].offset >= start && m_records[m_first].offset < start + size) dropOldest();
+
+	Record& record = m_records[(m_first + m_count) % m_records.size()];
+	record.offset = static_cast<uint32_t>(start);
+	record.size = static_cast<uint32_t>(size);
+	m_count++;
+	m_writePos = start + size;
+	m_bytesUsed += size;
+	return &m_arena[start];
+}
+
+void RewindBuffer::dropOldest()
+{
+	m_bytesUsed -= m_records[m_first].size;
+	m_first = (m_first + 1) % m_records.size();
+	m_count--;
+}
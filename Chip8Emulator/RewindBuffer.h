@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "Snapshot.h"
+
+// History of machine states in a fixed amount of memory, for stepping a Core backwards.
+// Only the newest state is kept whole. Every older one is stored as the XOR of it and the state after it, run length
+// encoded, so the zeros (everything that didn't change that frame) cost almost nothing. XOR works both ways, so
+// stepping back just applies the newest delta to the newest state and throws the delta away.
+// Deltas go into one preallocated ring of bytes; when it's full the oldest ones are dropped, nothing is allocated after
+// construction.
+class RewindBuffer
+{
+public:
+	static const size_t DEFAULT_BUDGET = 16 * 1024 * 1024; // bytes of deltas
+	static const size_t DEFAULT_MAX_FRAMES = 60 * 60 * 10;  // ten minutes at one state per 60Hz tick
+
+	RewindBuffer(size_t budget = DEFAULT_BUDGET, size_t maxFrames = DEFAULT_MAX_FRAMES);
+
+	void push(const Snapshot& snapshot); // becomes the newest state
+	bool stepBack(Snapshot& snapshot); // drops the newest state and returns the one before it, false if there isn't one
+	void clear();
+
+	size_t getFrameCount() const; // how many times stepBack can succeed
+	size_t getBytesUsed() const;
+
+private:
+	// worst case for one delta: every byte a literal, plus a run header per 128 bytes at most
+	static const size_t MAX_DELTA_SIZE = sizeof(Snapshot) + sizeof(Snapshot) / 64 + 16;
+
+	struct Record
+	{
+		uint32_t offset;
+		uint32_t size;
+	};
+
+	Snapshot m_newest;
+	bool m_hasNewest;
+
+	std::vector<uint8_t> m_arena;
+	size_t m_writePos; // everything from here to the end of the arena belongs to the oldest records (or nobody)
+	size_t m_bytesUsed;
+
+	std::vector<Record> m_records; // ring, oldest at m_first
+	size_t m_first;
+	size_t m_count;
+
+	uint8_t m_scratch[MAX_DELTA_SIZE];
+
+	static size_t encode(const uint8_t* from, const uint8_t* to, size_t size, uint8_t* out);
+	static void apply(const uint8_t* delta, size_t deltaSize, uint8_t* state);
+
+	uint8_t* reserve(size_t size); // makes room for a record at the head, dropping the oldest ones as needed
+	void dropOldest();
+};
@@ -0,0 +1,57 @@
+#include <fstream>
+#include <cstring>
+
+#include "Rom.h"
+
+const char* Rom::DEFAULT_PATH = ".\\c8roms\\c8games\\PONG";
+
+Rom::Rom()
+	: m_size(0)
+{
+}
+
+Rom::Status Rom::load(const char* path)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file.is_open()) return Status::NotFound;
+
+	std::streamoff size = file.tellg();
+	if (size < 0) return Status::ReadError;
+	if (static_cast<uint64_t>(size) > MAX_SIZE) return Status::TooLarge;
+
+	uint8_t buffer[MAX_SIZE];
+	file.seekg(0);
+	if (!file.read(reinterpret_cast<char*>(buffer), size)) return Status::ReadError;
+
+	return assign(buffer, static_cast<size_t>(size));
+}
+
+Rom::Status Rom::assign(const uint8_t* program, size_t size)
+{
+	if (size > MAX_SIZE) return Status::TooLarge;
+
+	memcpy(m_data, program, size);
+	m_size = size;
+	return Status::Ok;
+}
+
+const char* Rom::describe(Status status)
+{
+	switch (status)
+	{
+	case Status::Ok: return "ok";
+	case Status::NotFound: return "couldn't open the file";
+	case Status::TooLarge: return "too large, a ROM can be at most 3584 bytes";
+	default: return "read failed";
+	}
+}
+
+const uint8_t* Rom::getData() const
+{
+	return m_data;
+}
+
+size_t Rom::getSize() const
+{
+	return m_size;
+}
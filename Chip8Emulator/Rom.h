@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// A program image, read from disk once and kept resident, so any number of Cores (or resets of one) can load it
+// without touching the file again.
+class Rom
+{
+public:
+	static const size_t MAX_SIZE = 4096 - 0x0200; // everything above the interpreter area
+	static const char* DEFAULT_PATH;
+
+	enum class Status
+	{
+		Ok,
+		NotFound,
+		TooLarge, // rejected before reading anything
+		ReadError
+	};
+
+	Rom();
+
+	Status load(const char* path); // the whole file in one read, leaves the previous image alone on failure
+	Status assign(const uint8_t* program, size_t size); // for images that didn't come from a file
+
+	static const char* describe(Status status);
+
+	const uint8_t* getData() const;
+	size_t getSize() const;
+
+private:
+	uint8_t m_data[MAX_SIZE];
+	size_t m_size;
+};
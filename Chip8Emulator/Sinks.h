@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+
+// These (plus the Keypad it reads) are the only ways the Core talks to the outside world.
+// The Core never touches a window, GL context or sound card directly, so any of these can be swapped out
+// (e.g. the Null* versions below let a ROM run headless)
+
+class DisplaySink
+{
+public:
+	virtual ~DisplaySink() {}
+
+	// framebuffer is 32 rows of 64 bits, bit 63 is the leftmost pixel
+	virtual void present(const uint64_t* framebuffer) = 0;
+};
+
+class AudioSink
+{
+public:
+	virtual ~AudioSink() {}
+
+	// called whenever the sound timer goes from zero to non-zero or back
+	// cycle is the emulated time it happened at (Core::CYCLES_PER_SECOND per second), calls come in cycle order
+	virtual void setToneEnabled(bool enabled, uint64_t cycle) = 0;
+
+	// called at the end of every Core::run with the emulated time it got to, for sinks that need to follow the emulation clock
+	virtual void setEmulatedTime(uint64_t) {}
+};
+
+class NullDisplay : public DisplaySink
+{
+public:
+	void present(const uint64_t*) override {}
+};
+
+class NullAudio : public AudioSink
+{
+public:
+	void setToneEnabled(bool, uint64_t) override {}
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+// Everything Core needs to carry on exactly where it was, in one flat block.
+// It's plain data with a fixed layout, so the caller decides where it lives (stack, array, ring buffer, file)
+// and saving or loading is a couple of memcpys with no allocation.
+// Host side settings (sinks, dispatch engine, quirks) aren't machine state and stay with the core.
+struct Snapshot
+{
+	static const uint32_t MAGIC = 0x53384843; // "CH8S" in a little endian file
+	static const uint32_t VERSION = 1;		  // bump whenever the layout or meaning of a field changes
+
+	uint32_t magic;
+	uint32_t version;
+
+	uint64_t cycleCount;
+	uint64_t instructionCount;
+	uint64_t framebuffer[32];
+
+	uint32_t rngState; // minstd state word, the next Cxkk continues from it
+	uint16_t indexRegister;
+	uint16_t programCounter;
+	uint16_t stack[16];
+
+	uint8_t registers[16];
+	int8_t stackPointer;
+	uint8_t delayTimer;
+	uint8_t soundTimer;
+	uint8_t isWaitingForInput;
+	uint8_t pendingRegister;
+	uint8_t reserved[3]; // explicit padding, always zero so identical machines give identical bytes
+
+	uint8_t memory[4096];
+};
+
+static_assert(std::is_trivially_copyable<Snapshot>::value, "snapshots are copied around as raw bytes");
+static_assert(sizeof(Snapshot) == 4440, "snapshot layout changed, bump Snapshot::VERSION");
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Fixed size single producer / single consumer ring buffer.
+// push() is only ever called from one thread and pop() from one other thread, neither of them blocks or locks.
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+	static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+private:
+	T m_items[Capacity];
+	alignas(64) std::atomic<size_t> m_head; // next item to pop, only written by the consumer
+	alignas(64) std::atomic<size_t> m_tail; // next slot to push into, only written by the producer
+
+public:
+	SpscQueue() : m_head(0), m_tail(0) {}
+
+	// returns false (and drops the item) if the queue is full
+	bool push(const T& item)
+	{
+		size_t tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_head.load(std::memory_order_acquire) == Capacity) return false;
+
+		m_items[tail & (Capacity - 1)] = item;
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool pop(T& item)
+	{
+		size_t head = m_head.load(std::memory_order_relaxed);
+		if (head == m_tail.load(std::memory_order_acquire)) return false;
+
+		item = m_items[head & (Capacity - 1)];
+		m_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consumer side, looks at the next item without taking it
+	bool peek(T& item) const
+	{
+		size_t head = m_head.load(std::memory_order_relaxed);
+		if (head == m_tail.load(std::memory_order_acquire)) return false;
+
+		item = m_items[head & (Capacity - 1)];
+		return true;
+	}
+
+	size_t size() const
+	{
+		return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+	}
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+#include "Sinks.h"
+#include "BeeperAudio.h"
+
+// writes the beeper to a 16 bit mono WAV file instead of a sound card, for headless runs
+// samples are generated from emulated time (as Core::run reports it) so the file is the same however fast the host ran,
+// and every tone edge lands on the sample matching the cycle it happened on
+class WavFileAudio : public AudioSink
+{
+private:
+	static const size_t BLOCK_SAMPLES = 1024;
+
+	std::FILE* m_file;
+	BeeperAudio m_beeper;
+	uint64_t m_samplesWritten;
+
+	void writeHeader(uint32_t dataBytes);
+
+public:
+	WavFileAudio();
+	~WavFileAudio();
+
+	bool open(const std::string& path); // returns false if the file can't be created
+	void close(); // patches the sizes in the header, called by the destructor too
+
+	void setToneEnabled(bool enabled, uint64_t cycle) override;
+	void setEmulatedTime(uint64_t cycle) override; // writes samples up to this point
+};
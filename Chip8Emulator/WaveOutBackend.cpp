@@ -0,0 +1,47 @@
+#ifdef _WIN32
+
+#include "WaveOutBackend.h"
+#include "OlcNoiseMaker.h"
+
+WaveOutBackend::WaveOutBackend()
+	: m_sound(nullptr), m_source(nullptr)
+{
+}
+
+WaveOutBackend::~WaveOutBackend()
+{
+	close();
+}
+
+bool WaveOutBackend::open(SampleSource* source)
+{
+	std::vector<wstring> devices = olcNoiseMaker<short>::Enumerate();
+	if (devices.empty()) return false; // headless boxes and RDP sessions often have no output device
+
+	m_source = source;
+	m_sound = new olcNoiseMaker<short>(devices[0], SAMPLE_RATE, 1, BLOCK_COUNT, AdaptiveLatency::BLOCK_SAMPLES);
+	m_sound->SetBlockLimit(m_latency.getTargetSamples() / AdaptiveLatency::BLOCK_SAMPLES);
+	m_sound->SetBlockFunction(std::bind(&WaveOutBackend::fillBlock, this, std::placeholders::_1, std::placeholders::_2));
+	return true;
+}
+
+void WaveOutBackend::close()
+{
+	if (!m_sound) return;
+
+	m_sound->Stop(); // olcNoiseMaker's destructor doesn't join its thread
+	delete m_sound;
+	m_sound = nullptr;
+}
+
+// called on olcNoiseMaker's thread once a block is free and the limit allows another one
+void WaveOutBackend::fillBlock(short* block, unsigned int samples)
+{
+	// the block being filled has already been taken off the free count
+	m_latency.observe((m_sound->GetBlocksQueued() - 1) * AdaptiveLatency::BLOCK_SAMPLES);
+	m_source->render(block, samples);
+	m_latency.written(samples);
+	m_sound->SetBlockLimit(m_latency.getTargetSamples() / AdaptiveLatency::BLOCK_SAMPLES);
+}
+
+#endif
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "AudioBackend.h"
+
+#ifdef _WIN32
+
+template<class T> class olcNoiseMaker;
+
+// waveOut through olcNoiseMaker, Win32 only
+// enough blocks are allocated for the largest latency target, olcNoiseMaker's block limit keeps only the current target queued
+class WaveOutBackend : public AudioBackend
+{
+private:
+	static const unsigned int BLOCK_COUNT = AdaptiveLatency::MAX_SAMPLES / AdaptiveLatency::BLOCK_SAMPLES;
+
+	olcNoiseMaker<short>* m_sound;
+	SampleSource* m_source;
+
+	void fillBlock(short* block, unsigned int samples);
+
+public:
+	WaveOutBackend();
+	~WaveOutBackend();
+
+	bool open(SampleSource* source) override;
+	void close() override;
+	const char* getName() const override { return "waveout"; }
+};
+
+#endif
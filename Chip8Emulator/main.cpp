@@ -1,72 +1,544 @@
 #include <iostream>
 #include <chrono>
+#include <string>
+#include <cstdlib>
+#include <algorithm>
+#include <set>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <random>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
-#include "Shader.h"
 #include "Renderer.h"
 #include "Core.h"
-#include "Keys.h"
+#include "Keypad.h"
+#include "KeyMap.h"
+#include "Sinks.h"
+#include "GlfwSinks.h"
+#include "BatchRunner.h"
+#include "Rom.h"
+#include "LockstepEngine.h"
+#include "FrameClock.h"
+#include "FrameExchange.h"
+#include "EmulationThread.h"
+#include "RewindBuffer.h"
+#include "InputLog.h"
+#include "AudioBackend.h"
+#include "BeeperAudio.h"
+#include "WavFileAudio.h"
+#include "EngineCheck.h"
 
 GLFWwindow* initOpenGLEnvironment();
 void framebufferSizeCallback(GLFWwindow* window, int width, int height);
 void processGlobalInput(GLFWwindow* window);
+void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+
+// time from a key event to the first present after it
+struct LatencyStats
+{
+	int64_t lastEventTime = 0;
+	uint64_t samples = 0;
+	int64_t total = 0;
+	int64_t worst = 0;
+};
+void recordPresent(LatencyStats& stats, const Keypad& keypad);
+void reportLatency(const LatencyStats& stats);
+void reportAudio(const AudioBackend& audio, const BeeperAudio& beeper);
+
+// shared between the window thread (GLFW callbacks) and the render thread, found through the window user pointer
+struct WindowContext
+{
+	EmulationThread* emulation;
+	Keypad* keypad;
+	const KeyMap* keyMap;
+	FrameExchange* frames;
+	RenderMode renderMode;
+	std::atomic<bool> rendering;
+	std::atomic<uint32_t> viewportSize; // width << 16 | height, only the render thread can call glViewport
+	LatencyStats latency;				// render thread only until it's joined
+};
+void renderLoop(GLFWwindow* window, WindowContext* context);
+
+struct Options
+{
+	bool headless = false;
+	bool maxSpeed = false;
+	bool realtime = false; // headless only, run at native speed instead of uncapped
+	Dispatch dispatch = CHIP8_DEFAULT_DISPATCH;
+	RenderMode renderMode = RenderMode::Texture;
+	bool wrapSprites = false;
+	const char* romPath = Rom::DEFAULT_PATH;
+	const char* keyMapPath = KeyMap::DEFAULT_PATH;
+	std::string audioBackend = "auto"; // windowed only, "none" skips audio entirely
+	std::string wavPath;				// headless only, empty = no audio
+	bool seeded = false;				// single core modes, otherwise the RNG starts from std::random_device
+	uint32_t seed = 0;
+	std::string recordPath;				// windowed only, where to save the input log on exit
+	std::string replayPath;				// replays this input log headless instead of running anything else
+	unsigned int runAhead = 0;			// windowed at native speed only, ticks to run ahead of what's presented
+	size_t rewindMegabytes = RewindBuffer::DEFAULT_BUDGET / (1024 * 1024); // windowed at native speed only, 0 = off
+	uint64_t cycles = 600 * 60; // one emulated minute
+	unsigned int batch = 0;		// number of instances, 0 = not a batch run
+	unsigned int threads = 0;	// 0 = one per hardware thread
+	unsigned int lockstep = 0;	// number of SIMD lanes, 0 = not a lockstep run
+	bool verifyEngines = false; // compares every dispatch mode instead of running anything
+};
+
+int runHeadless(const Options& options);
+int runBatch(const Options& options);
+int runLockstep(const Options& options);
+int runWindowed(const Options& options);
+int runReplay(const Options& options);
+int runEngineCheck(const Options& options);
+void reportSpeed(const Core& core, std::chrono::steady_clock::duration elapsed);
+bool loadRom(const Options& options, Rom& rom);
 
 const int WINDOW_WIDTH = 640;
 const int WINDOW_HEIGHT = 320;
-const glm::mat4 PROJECTION_MATRIX = glm::ortho(
-	0.0f,  64.0f, // left to right
-	32.0f, 0.0f, // bottom to top
-	-1.0f, 1.0f  // near to far
-);
+const int REWIND_KEY = GLFW_KEY_BACKSPACE; // held down, steps back one tick per tick (unless the key map uses it)
+const int64_t RENDER_WAIT_TIMEOUT = 100000000; // nanoseconds the render thread sleeps before checking for shutdown
+const uint32_t PRESENT_RATE = Core::CYCLES_PER_SECOND / Core::CYCLES_PER_TIMER_TICK; // timer ticks (and presents) per second
 
-int main()
+int main(int argc, char** argv)
 {
+	Options options;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--headless")
+		{
+			options.headless = true;
+		}
+		else if (arg == "--realtime")
+		{
+			options.realtime = true;
+		}
+		else if (arg == "--max-speed")
+		{
+			options.maxSpeed = true;
+		}
+		else if (arg == "--dispatch" && i + 1 < argc)
+		{
+			std::string name = argv[++i];
+			if (name == "table") options.dispatch = Dispatch::Table;
+			else if (name == "switch") options.dispatch = Dispatch::Switch;
+			else if (name == "threaded") options.dispatch = Dispatch::Threaded;
+			else if (name == "cached") options.dispatch = Dispatch::Cached;
+			else if (name == "jit") options.dispatch = Dispatch::Jit;
+			else
+			{
+				std::cerr << "Unknown dispatch engine " << name << std::endl;
+				return 1;
+			}
+		}
+		else if (arg == "--cycles" && i + 1 < argc)
+		{
+			options.cycles = std::strtoull(argv[++i], nullptr, 10);
+		}
+		else if (arg == "--batch" && i + 1 < argc)
+		{
+			options.batch = std::strtoul(argv[++i], nullptr, 10);
+		}
+		else if (arg == "--threads" && i + 1 < argc)
+		{
+			options.threads = std::strtoul(argv[++i], nullptr, 10);
+		}
+		else if (arg == "--keys" && i + 1 < argc)
+		{
+			options.keyMapPath = argv[++i];
+		}
+		else if (arg == "--wrap-sprites")
+		{
+			options.wrapSprites = true;
+		}
+		else if (arg == "--renderer" && i + 1 < argc)
+		{
+			std::string name = argv[++i];
+			if (name == "texture") options.renderMode = RenderMode::Texture;
+			else if (name == "pixel") options.renderMode = RenderMode::PerPixel;
+			else
+			{
+				std::cerr << "Unknown renderer " << name << std::endl;
+				return 1;
+			}
+		}
+		else if (arg == "--lockstep" && i + 1 < argc)
+		{
+			options.lockstep = std::strtoul(argv[++i], nullptr, 10);
+		}
+		else if (arg == "--audio" && i + 1 < argc)
+		{
+			options.audioBackend = argv[++i];
+		}
+		else if (arg == "--wav" && i + 1 < argc)
+		{
+			options.wavPath = argv[++i];
+		}
+		else if (arg == "--seed" && i + 1 < argc)
+		{
+			options.seeded = true;
+			options.seed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (arg == "--record" && i + 1 < argc)
+		{
+			options.recordPath = argv[++i];
+		}
+		else if (arg == "--replay" && i + 1 < argc)
+		{
+			options.replayPath = argv[++i];
+		}
+		else if (arg == "--run-ahead" && i + 1 < argc)
+		{
+			options.runAhead = std::strtoul(argv[++i], nullptr, 10);
+		}
+		else if (arg == "--rewind" && i + 1 < argc)
+		{
+			options.rewindMegabytes = std::strtoul(argv[++i], nullptr, 10);
+		}
+		else if (arg == "--verify-engines")
+		{
+			options.verifyEngines = true;
+		}
+		else if (arg.compare(0, 2, "--") != 0)
+		{
+			options.romPath = argv[i];
+		}
+		else
+		{
+			std::cerr << "Usage: " << argv[0] << " [--headless [--realtime]] [--max-speed] [--dispatch table|switch|threaded|cached|jit] [--renderer texture|pixel] [--wrap-sprites] [--keys FILE] [--audio auto|waveout|pulse|alsa|none] [--wav FILE] [--seed N] [--record FILE] [--replay FILE] [--rewind MB] [--run-ahead N] [--cycles N] [--batch N [--threads N]] [--lockstep N] [--verify-engines] [ROM]" << std::endl;
+			return 1;
+		}
+	}
+
+	if (options.verifyEngines) return runEngineCheck(options);
+	if (!options.replayPath.empty()) return runReplay(options);
+	if (options.batch > 0) return runBatch(options);
+	if (options.lockstep > 0) return runLockstep(options);
+	if (options.headless) return runHeadless(options);
+	return runWindowed(options);
+}
+
+// runs the ROM as fast as the host allows without creating a window, GL context or audio device
+// timers are driven off the cycle count (600 cycles per emulated second) rather than the wall clock
+// with --realtime it runs at native speed instead, sleeping between 60Hz ticks
+// with --wav the beeper is written to a file, in slices of one timer tick so its queue of tone changes never fills up
+int runHeadless(const Options& options)
+{
+	NullDisplay display;
+	Keypad keypad; // nothing presses anything
+	NullAudio silence;
+	WavFileAudio wav;
+	if (!options.wavPath.empty() && !wav.open(options.wavPath))
+	{
+		std::cerr << "Couldn't create " << options.wavPath << std::endl;
+		return 1;
+	}
+	AudioSink* audio = options.wavPath.empty() ? static_cast<AudioSink*>(&silence) : &wav;
+	uint32_t slice = options.wavPath.empty() ? EmulationThread::MAX_SPEED_BATCH : Core::CYCLES_PER_TIMER_TICK;
+
+	Core core(&display, &keypad, audio);
+	core.setDispatch(options.dispatch);
+	core.setSpriteWrapping(options.wrapSprites);
+	if (options.seeded) core.seed(options.seed);
+
+	Rom rom;
+	if (!loadRom(options, rom)) return 1;
+	core.loadProgram(rom);
+
+	auto startTime = std::chrono::steady_clock::now();
+	if (options.realtime)
+	{
+		FrameClock clock(PRESENT_RATE);
+		while (core.getCycleCount() < options.cycles)
+		{
+			uint64_t remaining = options.cycles - core.getCycleCount();
+			uint64_t due = clock.takeDueTicks() * static_cast<uint64_t>(Core::CYCLES_PER_TIMER_TICK);
+			if (due > 0) core.run(static_cast<uint32_t>(std::min<uint64_t>(remaining, due)));
+			if (core.getIsIdle()) break; // nothing can press a key here, so it would wait forever
+			clock.sleepUntilNextTick();
+		}
+	}
+
+	while (core.getCycleCount() < options.cycles)
+	{
+		uint64_t remaining = options.cycles - core.getCycleCount();
+		core.run(static_cast<uint32_t>(std::min<uint64_t>(remaining, slice)));
+	}
+	reportSpeed(core, std::chrono::steady_clock::now() - startTime);
+
+	core.log();
+	return 0;
+}
+
+// runs options.batch headless instances of the ROM, each with its own RNG seed, across a thread pool
+int runBatch(const Options& options)
+{
+	std::shared_ptr<Rom> rom = std::make_shared<Rom>();
+	if (!loadRom(options, *rom)) return 1;
+
+	std::vector<BatchJob> jobs(options.batch);
+	for (unsigned int i = 0; i < options.batch; i++)
+	{
+		jobs[i].program = rom;
+		jobs[i].seed = i;
+		jobs[i].cycles = options.cycles;
+		jobs[i].wrapSprites = options.wrapSprites;
+	}
+
+	BatchRunner runner(options.threads, options.dispatch);
+	auto startTime = std::chrono::steady_clock::now();
+	std::vector<BatchResult> results = runner.run(jobs);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+	uint64_t instructions = 0;
+	std::set<uint64_t> distinctStates;
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		instructions += results[i].instructionCount;
+		distinctStates.insert(results[i].stateHash);
+	}
+
+	double mips = (seconds > 0.0) ? instructions / seconds / 1000000.0 : 0.0;
+	std::cout << std::dec << results.size() << " instances, " << distinctStates.size() << " distinct final states. Executed "
+		<< instructions << " instructions in " << seconds << "s: " << mips << " MIPS" << std::endl;
+	return 0;
+}
+
+// same as runBatch, but all instances run in one LockstepEngine on the calling thread
+int runLockstep(const Options& options)
+{
+	Rom rom;
+	if (!loadRom(options, rom)) return 1;
+
+	LockstepEngine engine(options.lockstep);
+	engine.setSpriteWrapping(options.wrapSprites);
+	engine.loadProgram(rom.getData(), rom.getSize());
+	for (unsigned int i = 0; i < options.lockstep; i++)
+	{
+		engine.seed(i, i);
+	}
+
+	auto startTime = std::chrono::steady_clock::now();
+	uint64_t remaining = options.cycles;
+	while (remaining > 0)
+	{
+		uint32_t slice = static_cast<uint32_t>(std::min<uint64_t>(remaining, EmulationThread::MAX_SPEED_BATCH));
+		engine.run(slice);
+		remaining -= slice;
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+	std::set<uint64_t> distinctStates;
+	for (unsigned int i = 0; i < options.lockstep; i++)
+	{
+		distinctStates.insert(engine.stateHash(i));
+	}
+
+	double mips = (seconds > 0.0) ? engine.getInstructionCount() / seconds / 1000000.0 : 0.0;
+	std::cout << std::dec << options.lockstep << " lanes, " << distinctStates.size() << " distinct final states. Executed "
+		<< engine.getInstructionCount() << " instructions in " << seconds << "s: " << mips << " MIPS" << std::endl;
+	return 0;
+}
+
+// plays an input log back headless at full speed and checks it ends in the recorded state
+// exits with 2 if it doesn't, so scripts can check a pile of logs against a new build
+int runReplay(const Options& options)
+{
+	InputLog inputLog;
+	if (!inputLog.load(options.replayPath.c_str()))
+	{
+		std::cerr << "Couldn't read " << options.replayPath << std::endl;
+		return 1;
+	}
+
+	Rom rom;
+	if (!loadRom(options, rom)) return 1;
+
+	NullDisplay display;
+	Keypad keypad;
+	NullAudio silence;
+	Core core(&display, &keypad, &silence);
+	core.setDispatch(options.dispatch);
+
+	auto startTime = std::chrono::steady_clock::now();
+	bool matched = inputLog.replay(core, keypad, rom);
+	reportSpeed(core, std::chrono::steady_clock::now() - startTime);
+
+	std::cout << "Replay of " << options.replayPath << (matched ? " matches the recording" : " diverged") << std::endl;
+	return matched ? 0 : 2;
+}
+
+// runs the built in test programs, plus the ROM if it loads, through every dispatch mode with fixed seeds and scripted
+// input. exits with 1 if any mode ends up somewhere different, the build runs this after linking
+int runEngineCheck(const Options& options)
+{
+	std::vector<EngineCheckCase> cases = EngineCheck::builtInCases();
+
+	std::shared_ptr<Rom> rom = std::make_shared<Rom>();
+	Rom::Status status = rom->load(options.romPath);
+	if (status == Rom::Status::Ok)
+	{
+		EngineCheckCase romCase = EngineCheck::romCase(options.romPath, rom);
+		romCase.job.wrapSprites = options.wrapSprites;
+		romCase.job.cycles = options.cycles;
+		romCase.job.input = EngineCheck::scriptedInput(options.cycles, romCase.job.seed);
+		cases.push_back(romCase);
+	}
+	else
+	{
+		std::cout << "Skipping " << options.romPath << ": " << Rom::describe(status) << std::endl;
+	}
+
+	bool agree = EngineCheck::run(cases);
+	std::cout << cases.size() << " programs, " << (agree ? "every dispatch mode agrees" : "dispatch modes DISAGREE") << std::endl;
+	return agree ? 0 : 1;
+}
+
+bool loadRom(const Options& options, Rom& rom)
+{
+	Rom::Status status = rom.load(options.romPath);
+	if (status != Rom::Status::Ok)
+	{
+		std::cerr << "Couldn't load " << options.romPath << ": " << Rom::describe(status) << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void reportSpeed(const Core& core, std::chrono::steady_clock::duration elapsed)
+{
+	double seconds = std::chrono::duration<double>(elapsed).count();
+	double mips = (seconds > 0.0) ? core.getInstructionCount() / seconds / 1000000.0 : 0.0;
+	std::cout << std::dec << "Executed " << core.getInstructionCount() << " instructions (" << core.getCycleCount() << " cycles) in "
+		<< seconds << "s: " << mips << " MIPS" << std::endl;
+}
+
+// three threads: this one only handles window events, the core runs on an EmulationThread and hands finished frames
+// to renderLoop through a FrameExchange. the audio backend pulls samples from the beeper on its own thread,
+// which gets tone changes through a queue. if no backend opens the core gets no audio sink at all
+int runWindowed(const Options& options)
+{
+	Rom rom;
+	if (!loadRom(options, rom)) return 1;
+
 	GLFWwindow* window = initOpenGLEnvironment();
 	if (!window) return 1;
 
-	Shader shader("shader.vert", "shader.frag");
-	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	KeyMap keyMap;
+	if (!keyMap.load(options.keyMapPath))
+	{
+		std::cout << "Couldn't open " << options.keyMapPath << ", using the default key layout." << std::endl;
+	}
+	Keypad keypad;
+	FrameExchange frames;
+	BeeperAudio beeper;
+	std::unique_ptr<AudioBackend> audio;
+	if (options.audioBackend != "none")
+	{
+		audio = AudioBackend::open(options.audioBackend, &beeper);
+		if (!audio) std::cout << "No audio device available (" << options.audioBackend << "), running silent." << std::endl;
+	}
+
+	Core core(&frames, &keypad, audio ? &beeper : nullptr);
+	core.setDispatch(options.dispatch);
+	core.setSpriteWrapping(options.wrapSprites);
+	core.loadProgram(rom);
 
-	shader.use();
-	shader.setMat4("projection", PROJECTION_MATRIX);
-	shader.setFloat("color", 1.0f, 1.0f, 1.0f);
+	// recording needs a seed it can write down
+	uint32_t seed = options.seeded ? options.seed : std::random_device{}();
+	core.seed(seed);
+	InputLog inputLog;
+	bool recording = !options.recordPath.empty();
+	if (recording) inputLog.begin(rom, seed, options.wrapSprites);
 
-	Core core(window);
-	glfwSetWindowUserPointer(window, &core);
-	glfwSetKeyCallback(window, Fx0AKeyCallback);
+	// uncapped there's no tick to record or rewind on
+	std::unique_ptr<RewindBuffer> rewind;
+	if (!options.maxSpeed && !recording && options.rewindMegabytes > 0) rewind.reset(new RewindBuffer(options.rewindMegabytes * 1024 * 1024));
 
-	double targetFramerate = 600.0;
-	double targetFrequency = 1.0 / targetFramerate;
+	EmulationThread emulation(core, keypad, options.maxSpeed, rewind.get(), recording ? &inputLog : nullptr);
+	emulation.setRunAhead(options.runAhead);
 
-	double initTime = glfwGetTime();
-	double lastFrameTime = initTime;
+	WindowContext context;
+	context.emulation = &emulation;
+	context.keypad = &keypad;
+	context.keyMap = &keyMap;
+	context.frames = &frames;
+	context.renderMode = options.renderMode;
+	context.rendering = true;
+	context.viewportSize = static_cast<uint32_t>(WINDOW_WIDTH) << 16 | static_cast<uint32_t>(WINDOW_HEIGHT);
+	glfwSetWindowUserPointer(window, &context);
+	glfwSetKeyCallback(window, keyCallback);
 
-	core.loadProgram();
+	// the GL context moves to the render thread
+	glfwMakeContextCurrent(nullptr);
+	std::thread renderer(renderLoop, window, &context);
+	emulation.start();
 
 	while (!glfwWindowShouldClose(window))
 	{
-		double currTime = glfwGetTime();
-		double deltaTime = currTime - lastFrameTime;
-		//std::cout << deltaTime << std::endl;
+		glfwWaitEvents();
 		processGlobalInput(window);
-		bool blocking = core.getIsWaitingForInput();
+	}
+
+	emulation.stop();
+	if (recording)
+	{
+		inputLog.end(core);
+		if (inputLog.save(options.recordPath.c_str()))
+			std::cout << "Recorded " << inputLog.getEventCount() << " key events to " << options.recordPath << std::endl;
+		else
+			std::cerr << "Couldn't write " << options.recordPath << std::endl;
+	}
+	if (audio)
+	{
+		audio->close();
+		reportAudio(*audio, beeper);
+	}
+	context.rendering = false;
+	frames.wake();
+	renderer.join();
+
+	if (options.maxSpeed) reportSpeed(core, emulation.getRunTime());
+	reportLatency(context.latency);
+	glfwTerminate();
+	return 0;
+}
 
-		if (deltaTime >= targetFrequency && !blocking)
+// owns the GL context, draws every frame the emulation thread publishes and nothing else
+void renderLoop(GLFWwindow* window, WindowContext* context)
+{
+	glfwMakeContextCurrent(window);
+	glfwSwapInterval(1); // waiting on vblank here only holds up this thread
+
+	{
+		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+		GlfwDisplay display(window, context->renderMode);
+		uint32_t viewportSize = context->viewportSize;
+
+		while (context->rendering)
 		{
-			core.opcode();
-			lastFrameTime = currTime;
-		}
+			bool newFrame = context->frames->waitForFrame(RENDER_WAIT_TIMEOUT);
 
-		// TODO: fix the off by one error in sound timer? maybe its just startup lag
-		core.updateSoundTimer(currTime);
-		core.updateDelayTimer(currTime);
+			bool resized = viewportSize != context->viewportSize;
+			if (resized)
+			{
+				viewportSize = context->viewportSize;
+				glViewport(0, 0, viewportSize >> 16, viewportSize & 0xFFFF);
+			}
 
-		glfwPollEvents();
+			if (newFrame || resized)
+			{
+				display.present(context->frames->getFrame());
+				if (newFrame) recordPresent(context->latency, *context->keypad);
+			}
+		}
 	}
 
-	glfwTerminate();
-	return 0;
+	glfwMakeContextCurrent(nullptr);
 }
 
 GLFWwindow* initOpenGLEnvironment()
@@ -100,11 +572,69 @@ GLFWwindow* initOpenGLEnvironment()
 
 void framebufferSizeCallback(GLFWwindow* window, int width, int height)
 {
-	glViewport(0, 0, width, height);
+	WindowContext* context = static_cast<WindowContext*>(glfwGetWindowUserPointer(window));
+	if (!context) return;
+
+	context->viewportSize = static_cast<uint32_t>(width) << 16 | static_cast<uint32_t>(height);
+	context->frames->wake();
 }
 
 void processGlobalInput(GLFWwindow* window)
 {
 	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, true);
-}
\ No newline at end of file
+}
+
+// passes host key events for the chip8 keys on to the emulation thread, which updates the keypad and resumes Fx0A
+// REWIND_KEY isn't a chip8 key, the emulation thread rewinds for as long as it's held
+void keyCallback(GLFWwindow* window, int key, int, int action, int)
+{
+	if (action == GLFW_REPEAT) return;
+
+	WindowContext* context = static_cast<WindowContext*>(glfwGetWindowUserPointer(window));
+	int chip8Key = context->keyMap->findKey(key);
+	if (chip8Key < 0)
+	{
+		if (key == REWIND_KEY) context->emulation->setRewinding(action == GLFW_PRESS);
+		return;
+	}
+
+	KeyEvent event = { static_cast<uint8_t>(chip8Key), action == GLFW_PRESS, FrameClock::now() };
+	context->emulation->postKeyEvent(event);
+}
+
+void recordPresent(LatencyStats& stats, const Keypad& keypad)
+{
+	int64_t eventTime = keypad.getLastEventTime();
+	if (eventTime == stats.lastEventTime) return; // nothing new since the last present
+
+	int64_t latency = FrameClock::now() - eventTime;
+	stats.lastEventTime = eventTime;
+	stats.samples++;
+	stats.total += latency;
+	stats.worst = std::max(stats.worst, latency);
+}
+
+void reportLatency(const LatencyStats& stats)
+{
+	if (stats.samples == 0) return;
+
+	double average = static_cast<double>(stats.total) / stats.samples / 1000000.0;
+	double worst = static_cast<double>(stats.worst) / 1000000.0;
+	std::cout << std::dec << "Input to present latency over " << stats.samples << " key events: " << average << "ms average, "
+		<< worst << "ms worst" << std::endl;
+}
+
+void reportAudio(const AudioBackend& audio, const BeeperAudio& beeper)
+{
+	AudioStats stats = audio.getStats();
+	double seconds = static_cast<double>(stats.samplesWritten) / AudioBackend::SAMPLE_RATE;
+	double target = stats.targetSamples * 1000.0 / AudioBackend::SAMPLE_RATE;
+	double adjust = (beeper.getRate() - 1.0) * 1000000.0;
+	std::cout << std::dec << "Audio (" << audio.getName() << "): " << stats.underruns << " underruns in " << seconds << "s, settled on "
+		<< target << "ms queued, rate control at " << adjust << "ppm" << std::endl;
+	if (beeper.getDroppedEdges() > 0)
+	{
+		std::cout << beeper.getDroppedEdges() << " tone changes were collapsed, the audio thread fell too far behind to queue them" << std::endl;
+	}
+}
@@ -1,9 +1,19 @@
 #version 330 core
 out vec4 FragColor;
 
+in vec2 pixel;
+
 uniform vec3 color;
+uniform bool unpack;            // texture mode, otherwise every fragment is lit
+uniform usampler2D framebuffer; // 2 x 32, 32 pixels per texel, MSB is the leftmost pixel
 
 void main()
 {
+    if (unpack)
+    {
+        ivec2 position = ivec2(pixel);
+        uint bits = texelFetch(framebuffer, ivec2(position.x / 32, position.y), 0).r;
+        if (((bits >> uint(31 - position.x % 32)) & 1u) == 0u) discard;
+    }
     FragColor = vec4(color, 1.0);
 }
\ No newline at end of file
@@ -5,7 +5,10 @@ layout (location = 0) in vec2 position;
 uniform mat4 projection;
 uniform mat4 model;
 
+out vec2 pixel; // position in chip8 pixels, (0, 0) to (64, 32)
+
 void main()
 {
+    pixel = (model * vec4(position, 0.0, 1.0)).xy;
     gl_Position = projection * model * vec4(position, 0.0, 1.0);
 }
\ No newline at end of file